@@ -889,6 +889,131 @@ static void test_HeapQueryInformation(void)
     ok(info == 0 || info == 1 || info == 2, "expected 0, 1 or 2, got %lu\n", info);
 }
 
+static void test_HeapSetInformation(void)
+{
+    BYTE *ptrs[0x120], *p;
+    SIZE_T i, j, size;
+    ULONG info;
+    HANDLE heap;
+    BOOL ret;
+
+    heap = HeapCreate( 0, 0, 0 );
+    ok( heap != NULL, "HeapCreate failed, error %lu\n", GetLastError() );
+
+    info = 2;
+    SetLastError( 0xdeadbeef );
+    ret = HeapSetInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    ok( ret, "HeapSetInformation failed, error %lu\n", GetLastError() );
+
+    info = 0xdeadbeef;
+    ret = pHeapQueryInformation( heap, HeapCompatibilityInformation, &info, sizeof(info), NULL );
+    ok( ret, "HeapQueryInformation failed, error %lu\n", GetLastError() );
+    ok( info == 2, "expected 2, got %lu\n", info );
+
+    for (i = 0; i < ARRAY_SIZE(ptrs); i++)
+    {
+        size = i * 0x11;
+        ptrs[i] = HeapAlloc( heap, HEAP_ZERO_MEMORY, size );
+        ok( ptrs[i] != NULL, "HeapAlloc %Iu failed\n", size );
+        for (j = 0; j < size; j++) if (ptrs[i][j]) break;
+        ok( j == size, "block %Iu not zeroed at %Iu\n", size, j );
+        memset( ptrs[i], i, size );
+        ok( HeapSize( heap, 0, ptrs[i] ) == size, "got size %Iu, expected %Iu\n",
+            HeapSize( heap, 0, ptrs[i] ), size );
+        ok( HeapValidate( heap, 0, ptrs[i] ), "HeapValidate failed for %p\n", ptrs[i] );
+    }
+
+    for (i = 0; i < ARRAY_SIZE(ptrs); i++)
+    {
+        size = i * 0x11;
+        for (j = 0; j < size; j++) if (ptrs[i][j] != (BYTE)i) break;
+        ok( j == size, "block %Iu corrupted at %Iu\n", size, j );
+    }
+
+    for (i = 1; i < ARRAY_SIZE(ptrs); i += 2)
+    {
+        size = i * 0x11;
+        p = HeapReAlloc( heap, HEAP_ZERO_MEMORY, ptrs[i], size * 2 );
+        ok( p != NULL, "HeapReAlloc %Iu failed\n", size * 2 );
+        for (j = 0; j < size; j++) if (p[j] != (BYTE)i) break;
+        ok( j == size, "block %Iu not copied at %Iu\n", size, j );
+        for (; j < size * 2; j++) if (p[j]) break;
+        ok( j == size * 2, "block %Iu not zeroed at %Iu\n", size * 2, j );
+        ok( HeapSize( heap, 0, p ) == size * 2, "got size %Iu, expected %Iu\n",
+            HeapSize( heap, 0, p ), size * 2 );
+        ptrs[i] = p;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(ptrs); i++)
+    {
+        ret = HeapFree( heap, 0, ptrs[i] );
+        ok( ret, "HeapFree failed for %p\n", ptrs[i] );
+    }
+
+    ret = HeapDestroy( heap );
+    ok( ret, "HeapDestroy failed, error %lu\n", GetLastError() );
+}
+
+static DWORD WINAPI free_blocks_thread( void *arg )
+{
+    BYTE **ptrs = arg;
+    SIZE_T i, j;
+    BOOL ret;
+
+    for (i = 0; i < 0x100; i++)
+    {
+        for (j = 0; j < (i & 0x3f); j++) if (ptrs[i][j] != (BYTE)i) break;
+        ok( j == (i & 0x3f), "block %Iu corrupted at %Iu\n", i, j );
+        ret = HeapFree( GetProcessHeap(), 0, ptrs[i] );
+        ok( ret, "HeapFree failed for %p\n", ptrs[i] );
+        /* reuse the freed blocks from this thread */
+        ptrs[i] = HeapAlloc( GetProcessHeap(), 0, i & 0x3f );
+        ok( ptrs[i] != NULL, "HeapAlloc failed\n" );
+        memset( ptrs[i], ~i, i & 0x3f );
+    }
+    return 0;
+}
+
+static void test_heap_threads(void)
+{
+    PROCESS_HEAP_ENTRY entry;
+    BYTE *ptrs[0x100];
+    HANDLE thread;
+    SIZE_T i, j;
+    BOOL ret;
+
+    for (i = 0; i < ARRAY_SIZE(ptrs); i++)
+    {
+        ptrs[i] = HeapAlloc( GetProcessHeap(), 0, i & 0x3f );
+        ok( ptrs[i] != NULL, "HeapAlloc failed\n" );
+        memset( ptrs[i], i, i & 0x3f );
+    }
+
+    /* blocks freed by another thread, and allocated again after it exits */
+    thread = CreateThread( NULL, 0, free_blocks_thread, ptrs, 0, NULL );
+    ok( thread != NULL, "CreateThread failed, error %lu\n", GetLastError() );
+    WaitForSingleObject( thread, INFINITE );
+    CloseHandle( thread );
+
+    ret = HeapValidate( GetProcessHeap(), 0, NULL );
+    ok( ret, "HeapValidate failed\n" );
+
+    HeapLock( GetProcessHeap() );
+    memset( &entry, 0, sizeof(entry) );
+    for (i = 0; i < 0x100000; i++) if (!HeapWalk( GetProcessHeap(), &entry )) break;
+    ok( GetLastError() == ERROR_NO_MORE_ITEMS, "HeapWalk failed, error %lu\n", GetLastError() );
+    HeapUnlock( GetProcessHeap() );
+
+    for (i = 0; i < ARRAY_SIZE(ptrs); i++)
+    {
+        for (j = 0; j < (i & 0x3f); j++) if (ptrs[i][j] != (BYTE)~i) break;
+        ok( j == (i & 0x3f), "block %Iu corrupted at %Iu\n", i, j );
+        ok( HeapValidate( GetProcessHeap(), 0, ptrs[i] ), "HeapValidate failed for %p\n", ptrs[i] );
+        ret = HeapFree( GetProcessHeap(), 0, ptrs[i] );
+        ok( ret, "HeapFree failed for %p\n", ptrs[i] );
+    }
+}
+
 static void test_heap_checks( DWORD flags )
 {
     BYTE old, *p, *p2;
@@ -1320,6 +1445,8 @@ START_TEST(heap)
     test_sized_HeapReAlloc((1 << 20), 1);
 
     test_HeapQueryInformation();
+    test_HeapSetInformation();
+    test_heap_threads();
     test_GetPhysicallyInstalledSystemMemory();
     test_GlobalMemoryStatus();
 
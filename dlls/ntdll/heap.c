@@ -78,6 +78,8 @@ typedef struct
 #define ARENA_PENDING_MAGIC    0xbedead
 #define ARENA_FREE_MAGIC       0x45455246
 #define ARENA_LARGE_MAGIC      0x6752614c
+#define ARENA_LFH_MAGIC        0x48464c
+#define ARENA_LFH_FREE_MAGIC   0x68666c
 
 #define ARENA_INUSE_FILLER     0x55
 #define ARENA_TAIL_FILLER      0xab
@@ -141,6 +143,8 @@ typedef struct tagSUBHEAP
 
 #define SUBHEAP_MAGIC    ((DWORD)('S' | ('U'<<8) | ('B'<<16) | ('H'<<24)))
 
+struct tagHEAP_LFH;
+
 typedef struct tagHEAP
 {
     DWORD_PTR        unknown1[2];
@@ -163,6 +167,7 @@ typedef struct tagHEAP
     ARENA_INUSE    **pending_free;  /* Ring buffer for pending free requests */
     RTL_CRITICAL_SECTION critSection; /* Critical section for serialization */
     FREE_LIST_ENTRY *freeList;      /* Free lists */
+    struct tagHEAP_LFH *lfh;        /* Low-fragmentation heap front end, if enabled */
 } HEAP;
 
 #define HEAP_MAGIC       ((DWORD)('H' | ('E'<<8) | ('A'<<16) | ('P'<<24)))
@@ -177,6 +182,83 @@ typedef struct tagHEAP
 #define HEAP_VALIDATE_ALL     0x20000000
 #define HEAP_VALIDATE_PARAMS  0x40000000
 
+/* Low-fragmentation heap: small blocks are carved from fixed-size groups,
+ * grouped in size classes ("bins"), each with one instance per affinity slot
+ * so that threads don't contend on the heap critical section. */
+
+#define HEAP_LFH_GROUP_SIZE     0x10000  /* size of a block group, aligned to its size */
+#define HEAP_LFH_MAX_SIZE       0x1000   /* largest request served by the LFH */
+#define HEAP_LFH_SMALL_LIMIT    0x200    /* bins are ALIGNMENT apart up to this size */
+#define HEAP_LFH_LARGE_STEP     0x80     /* and HEAP_LFH_LARGE_STEP apart above it */
+#define HEAP_LFH_NB_BINS        (HEAP_LFH_SMALL_LIMIT / ALIGNMENT + \
+                                 (HEAP_LFH_MAX_SIZE - HEAP_LFH_SMALL_LIMIT) / HEAP_LFH_LARGE_STEP)
+#define HEAP_LFH_AFFINITY_SLOTS 8
+#ifdef _WIN64
+#define HEAP_LFH_RESERVE_SIZE   0x10000000  /* address space reserved for the groups */
+#else
+#define HEAP_LFH_RESERVE_SIZE   0x1000000
+#endif
+
+C_ASSERT( HEAP_LFH_LARGE_STEP + ARENA_OFFSET <= 0xff );  /* must fit in unused_bytes */
+
+struct tagLFH_BIN;
+
+typedef struct tagLFH_GROUP
+{
+    DWORD              magic;       /* Magic number */
+    DWORD              block_size;  /* Size of the blocks, without the arena */
+    DWORD              block_count; /* Number of blocks in the group */
+    DWORD              free_count;  /* Number of free blocks in the group */
+    DWORD              next_unused; /* Index of the first never allocated block */
+    struct tagLFH_BIN *bin;         /* Bin owning the group */
+    struct list        entry;       /* Entry in the bin list of groups with free blocks */
+    ARENA_INUSE       *free_list;   /* First free block, linked through the block data */
+} LFH_GROUP;
+
+#define LFH_GROUP_MAGIC  ((DWORD)('L' | ('F'<<8) | ('H'<<16) | ('G'<<24)))
+#define LFH_GROUP_HEADER_SIZE  (((sizeof(LFH_GROUP) + ALIGNMENT - 1) & ~(ALIGNMENT - 1)) + ARENA_OFFSET)
+
+typedef struct tagLFH_BIN
+{
+    RTL_SRWLOCK        lock;        /* Lock protecting the bin and its groups */
+    struct list        groups;      /* Groups with free blocks */
+    DWORD              block_size;  /* Size of the blocks, without the arena */
+} LFH_BIN;
+
+typedef struct tagHEAP_LFH
+{
+    char              *base;        /* Address range reserved for the groups */
+    SIZE_T             size;
+    RTL_SRWLOCK        lock;        /* Lock protecting the group allocation */
+    DWORD              nb_groups;   /* Number of group slots in the reserved range */
+    DWORD              next_group;  /* Index of the first never used group slot */
+    DWORD              nb_free;     /* Number of released group slots */
+    DWORD             *free_groups; /* Released group slots */
+    BYTE              *group_used;  /* Whether each group slot is committed */
+    LFH_BIN            bins[HEAP_LFH_AFFINITY_SLOTS][HEAP_LFH_NB_BINS];
+} HEAP_LFH;
+
+/* Per-thread cache of free LFH blocks of the process heap, so that a thread
+ * freeing and reallocating small blocks doesn't contend with other threads.
+ * The cache lock is only taken by other threads to flush the cache. */
+
+#define HEAP_CACHE_NB_BINS  (HEAP_LFH_SMALL_LIMIT / ALIGNMENT)  /* only cache the small bins */
+#define HEAP_CACHE_DEPTH    16                                  /* max cached blocks per bin */
+
+typedef struct
+{
+    RTL_SRWLOCK        lock;        /* Lock protecting the cache against flushes by other threads */
+    struct list        entry;       /* Entry in the list of thread caches */
+    DWORD              count[HEAP_CACHE_NB_BINS];
+    ARENA_INUSE       *blocks[HEAP_CACHE_NB_BINS][HEAP_CACHE_DEPTH];
+} HEAP_THREAD_CACHE;
+
+/* the cache must not be allocated from the LFH itself */
+C_ASSERT( sizeof(HEAP_THREAD_CACHE) > HEAP_LFH_MAX_SIZE );
+
+static struct list thread_caches = LIST_INIT( thread_caches );
+static RTL_SRWLOCK thread_caches_lock = RTL_SRWLOCK_INIT;
+
 static HEAP *processHeap;  /* main process heap */
 
 static BOOL HEAP_IsRealArena( HEAP *heapPtr, DWORD flags, LPCVOID block, BOOL quiet );
@@ -869,6 +951,621 @@ static BOOL validate_large_arena( HEAP *heap, const ARENA_LARGE *arena, BOOL qui
 }
 
 
+/***********************************************************************
+ *           get_lfh_bin_index
+ */
+static inline unsigned int get_lfh_bin_index( SIZE_T size )
+{
+    if (size <= HEAP_LFH_SMALL_LIMIT) return size ? (size - 1) / ALIGNMENT : 0;
+    return HEAP_LFH_SMALL_LIMIT / ALIGNMENT + (size - HEAP_LFH_SMALL_LIMIT - 1) / HEAP_LFH_LARGE_STEP;
+}
+
+
+/***********************************************************************
+ *           get_lfh_bin_size
+ *
+ * Size of the user data of the blocks of a bin.
+ */
+static inline SIZE_T get_lfh_bin_size( unsigned int index )
+{
+    if (index < HEAP_LFH_SMALL_LIMIT / ALIGNMENT) return (index + 1) * ALIGNMENT;
+    return HEAP_LFH_SMALL_LIMIT + (index - HEAP_LFH_SMALL_LIMIT / ALIGNMENT + 1) * HEAP_LFH_LARGE_STEP;
+}
+
+
+/***********************************************************************
+ *           get_lfh_affinity
+ */
+static inline unsigned int get_lfh_affinity(void)
+{
+    return (HandleToULong( NtCurrentTeb()->ClientId.UniqueThread ) >> 2) % HEAP_LFH_AFFINITY_SLOTS;
+}
+
+
+/***********************************************************************
+ *           is_lfh_block
+ *
+ * Check whether a block pointer lies in the low-fragmentation heap range.
+ */
+static inline BOOL is_lfh_block( const HEAP *heap, const void *ptr )
+{
+    const HEAP_LFH *lfh = heap->lfh;
+    return lfh && (SIZE_T)((const char *)ptr - lfh->base) < lfh->size;
+}
+
+
+/***********************************************************************
+ *           find_lfh_group
+ *
+ * Find the group containing an arena, checking that it is at a valid position.
+ */
+static LFH_GROUP *find_lfh_group( HEAP *heap, const ARENA_INUSE *arena )
+{
+    HEAP_LFH *lfh = heap->lfh;
+    SIZE_T offset = (const char *)arena - lfh->base;
+    unsigned int index = offset / HEAP_LFH_GROUP_SIZE;
+    LFH_GROUP *group;
+    SIZE_T stride;
+
+    if (!lfh->group_used[index]) return NULL;
+    group = (LFH_GROUP *)(lfh->base + (SIZE_T)index * HEAP_LFH_GROUP_SIZE);
+    offset -= (SIZE_T)index * HEAP_LFH_GROUP_SIZE;
+    if (offset < LFH_GROUP_HEADER_SIZE) return NULL;
+    offset -= LFH_GROUP_HEADER_SIZE;
+    stride = sizeof(ARENA_INUSE) + group->block_size;
+    if (offset % stride || offset / stride >= group->block_count) return NULL;
+    return group;
+}
+
+
+/***********************************************************************
+ *           validate_lfh_block
+ */
+static BOOL validate_lfh_block( HEAP *heap, const ARENA_INUSE *arena, BOOL quiet )
+{
+    const LFH_GROUP *group = find_lfh_group( heap, arena );
+
+    if (!group || group->magic != LFH_GROUP_MAGIC)
+    {
+        if (quiet == NOISY) ERR( "Heap %p: invalid LFH block pointer %p\n", heap, arena + 1 );
+        else WARN( "Heap %p: invalid LFH block pointer %p\n", heap, arena + 1 );
+        return FALSE;
+    }
+    if (arena->magic == ARENA_LFH_FREE_MAGIC)
+    {
+        if (quiet == NOISY) ERR( "Heap %p: LFH block %p used after free\n", heap, arena + 1 );
+        else WARN( "Heap %p: LFH block %p used after free\n", heap, arena + 1 );
+        return FALSE;
+    }
+    if (arena->magic != ARENA_LFH_MAGIC || arena->size != group->block_size ||
+        arena->unused_bytes > arena->size)
+    {
+        if (quiet == NOISY) ERR( "Heap %p: invalid LFH arena %p values %x/%x\n", heap, arena, arena->size, arena->magic );
+        else WARN( "Heap %p: invalid LFH arena %p values %x/%x\n", heap, arena, arena->size, arena->magic );
+        return FALSE;
+    }
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           create_lfh_group
+ */
+static LFH_GROUP *create_lfh_group( HEAP *heap, LFH_BIN *bin )
+{
+    HEAP_LFH *lfh = heap->lfh;
+    SIZE_T size = HEAP_LFH_GROUP_SIZE;
+    LFH_GROUP *group;
+    unsigned int index;
+    void *addr;
+
+    RtlAcquireSRWLockExclusive( &lfh->lock );
+    if (lfh->nb_free) index = lfh->free_groups[--lfh->nb_free];
+    else if (lfh->next_group < lfh->nb_groups) index = lfh->next_group++;
+    else
+    {
+        RtlReleaseSRWLockExclusive( &lfh->lock );
+        WARN( "Heap %p: no more LFH groups\n", heap );
+        return NULL;
+    }
+
+    addr = lfh->base + (SIZE_T)index * HEAP_LFH_GROUP_SIZE;
+    if (NtAllocateVirtualMemory( NtCurrentProcess(), &addr, 0, &size, MEM_COMMIT,
+                                 get_protection_type( heap->flags ) ))
+    {
+        lfh->free_groups[lfh->nb_free++] = index;
+        RtlReleaseSRWLockExclusive( &lfh->lock );
+        WARN( "Heap %p: could not commit LFH group %p\n", heap, addr );
+        return NULL;
+    }
+
+    group = addr;
+    group->magic       = LFH_GROUP_MAGIC;
+    group->block_size  = bin->block_size;
+    group->block_count = (HEAP_LFH_GROUP_SIZE - LFH_GROUP_HEADER_SIZE) / (sizeof(ARENA_INUSE) + bin->block_size);
+    group->free_count  = group->block_count;
+    group->next_unused = 0;
+    group->bin         = bin;
+    group->free_list   = NULL;
+    lfh->group_used[index] = 1;
+    RtlReleaseSRWLockExclusive( &lfh->lock );
+    return group;
+}
+
+
+/***********************************************************************
+ *           release_lfh_group
+ */
+static void release_lfh_group( HEAP *heap, LFH_GROUP *group )
+{
+    HEAP_LFH *lfh = heap->lfh;
+    unsigned int index = ((char *)group - lfh->base) / HEAP_LFH_GROUP_SIZE;
+    SIZE_T size = HEAP_LFH_GROUP_SIZE;
+    void *addr = group;
+
+    RtlAcquireSRWLockExclusive( &lfh->lock );
+    lfh->group_used[index] = 0;
+    NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_DECOMMIT );
+    lfh->free_groups[lfh->nb_free++] = index;
+    RtlReleaseSRWLockExclusive( &lfh->lock );
+}
+
+
+/***********************************************************************
+ *           allocate_lfh_block
+ *
+ * Allocate a small block from the low-fragmentation heap, without taking the heap lock.
+ */
+static void *allocate_lfh_block( HEAP *heap, DWORD flags, SIZE_T size )
+{
+    LFH_BIN *bin = &heap->lfh->bins[get_lfh_affinity()][get_lfh_bin_index( size )];
+    LFH_GROUP *group;
+    ARENA_INUSE *arena;
+    struct list *ptr;
+
+    RtlAcquireSRWLockExclusive( &bin->lock );
+    if (!(ptr = list_head( &bin->groups )))
+    {
+        /* don't hold the bin lock while allocating the group */
+        RtlReleaseSRWLockExclusive( &bin->lock );
+        if (!(group = create_lfh_group( heap, bin ))) return NULL;
+        RtlAcquireSRWLockExclusive( &bin->lock );
+        list_add_head( &bin->groups, &group->entry );
+    }
+    else group = LIST_ENTRY( ptr, LFH_GROUP, entry );
+
+    if ((arena = group->free_list)) group->free_list = *(ARENA_INUSE **)(arena + 1);
+    else arena = (ARENA_INUSE *)((char *)group + LFH_GROUP_HEADER_SIZE +
+                                 group->next_unused++ * (sizeof(ARENA_INUSE) + group->block_size));
+    if (!--group->free_count) list_remove( &group->entry );
+    arena->size  = group->block_size;
+    arena->magic = ARENA_LFH_MAGIC;
+    RtlReleaseSRWLockExclusive( &bin->lock );
+
+    arena->unused_bytes = arena->size - size;
+    notify_alloc( arena + 1, size, flags & HEAP_ZERO_MEMORY );
+    initialize_block( arena + 1, size, arena->unused_bytes, flags );
+    return arena + 1;
+}
+
+
+/***********************************************************************
+ *           put_lfh_block
+ *
+ * Return a block to its group. The bin lock must be held.
+ */
+static BOOL put_lfh_block( LFH_GROUP *group, ARENA_INUSE *arena )
+{
+    LFH_BIN *bin = group->bin;
+
+    arena->magic = ARENA_LFH_FREE_MAGIC;
+    *(ARENA_INUSE **)(arena + 1) = group->free_list;
+    group->free_list = arena;
+    if (!group->free_count++) list_add_head( &bin->groups, &group->entry );
+
+    /* release the group when it's empty, unless it's the last one of the bin */
+    if (group->free_count != group->block_count || list_head( &bin->groups ) == list_tail( &bin->groups ))
+        return FALSE;
+    list_remove( &group->entry );
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           free_lfh_block
+ */
+static BOOL free_lfh_block( HEAP *heap, void *ptr )
+{
+    ARENA_INUSE *arena = (ARENA_INUSE *)ptr - 1;
+    LFH_GROUP *group;
+    LFH_BIN *bin;
+    BOOL release;
+
+    if (!(group = find_lfh_group( heap, arena )) || group->magic != LFH_GROUP_MAGIC)
+    {
+        WARN( "Heap %p: invalid LFH block pointer %p\n", heap, ptr );
+        return FALSE;
+    }
+    bin = group->bin;
+
+    RtlAcquireSRWLockExclusive( &bin->lock );
+    if (arena->magic != ARENA_LFH_MAGIC)
+    {
+        RtlReleaseSRWLockExclusive( &bin->lock );
+        WARN( "Heap %p: invalid LFH arena magic %08x for %p\n", heap, arena->magic, arena );
+        return FALSE;
+    }
+    release = put_lfh_block( group, arena );
+    RtlReleaseSRWLockExclusive( &bin->lock );
+
+    if (release) release_lfh_group( heap, group );
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           realloc_lfh_block
+ */
+static void *realloc_lfh_block( HEAP *heap, DWORD flags, void *ptr, SIZE_T size )
+{
+    ARENA_INUSE *arena = (ARENA_INUSE *)ptr - 1;
+    SIZE_T old_size = arena->size - arena->unused_bytes;
+    void *new_ptr;
+
+    if (size <= arena->size && arena->size - size <= 0xff)
+    {
+        notify_realloc( ptr, old_size, size );
+        arena->unused_bytes = arena->size - size;
+        if (size > old_size)
+            initialize_block( (char *)ptr + old_size, size - old_size, arena->unused_bytes, flags );
+        else
+            mark_block_tail( (char *)ptr + size, arena->unused_bytes, flags );
+        return ptr;
+    }
+    if (flags & HEAP_REALLOC_IN_PLACE_ONLY) return NULL;
+    if (!(new_ptr = RtlAllocateHeap( heap, flags & (HEAP_NO_SERIALIZE | HEAP_ZERO_MEMORY), size )))
+        return NULL;
+    memcpy( new_ptr, ptr, min( old_size, size ));
+    notify_free( ptr );
+    free_lfh_block( heap, ptr );
+    return new_ptr;
+}
+
+
+/***********************************************************************
+ *           get_lfh_group_block
+ *
+ * Get a block of a group by index. The bin lock must be held.
+ */
+static inline ARENA_INUSE *get_lfh_group_block( const LFH_GROUP *group, DWORD index )
+{
+    return (ARENA_INUSE *)((char *)group + LFH_GROUP_HEADER_SIZE +
+                           index * (sizeof(ARENA_INUSE) + group->block_size));
+}
+
+
+/***********************************************************************
+ *           validate_lfh_groups
+ *
+ * Validate all the blocks of the low-fragmentation heap.
+ */
+static BOOL validate_lfh_groups( HEAP *heap )
+{
+    HEAP_LFH *lfh = heap->lfh;
+    const ARENA_INUSE *arena;
+    LFH_GROUP *group;
+    DWORD i, j;
+    BOOL ret = TRUE;
+
+    RtlAcquireSRWLockExclusive( &lfh->lock );
+    for (i = 0; ret && i < lfh->next_group; i++)
+    {
+        if (!lfh->group_used[i]) continue;
+        group = (LFH_GROUP *)(lfh->base + (SIZE_T)i * HEAP_LFH_GROUP_SIZE);
+        if (group->magic != LFH_GROUP_MAGIC)
+        {
+            ERR( "Heap %p: invalid LFH group %p magic %08x\n", heap, group, group->magic );
+            ret = FALSE;
+            break;
+        }
+        RtlAcquireSRWLockShared( &group->bin->lock );
+        for (j = 0; ret && j < group->next_unused; j++)
+        {
+            arena = get_lfh_group_block( group, j );
+            if (arena->magic != ARENA_LFH_FREE_MAGIC) ret = validate_lfh_block( heap, arena, NOISY );
+            else if (arena->size != group->block_size)
+            {
+                ERR( "Heap %p: invalid free LFH arena %p size %x\n", heap, arena, arena->size );
+                ret = FALSE;
+            }
+        }
+        RtlReleaseSRWLockShared( &group->bin->lock );
+    }
+    RtlReleaseSRWLockExclusive( &lfh->lock );
+    return ret;
+}
+
+
+/***********************************************************************
+ *           walk_lfh_blocks
+ *
+ * Find the low-fragmentation heap block following prev, or the first one if prev is NULL.
+ */
+static NTSTATUS walk_lfh_blocks( HEAP *heap, PROCESS_HEAP_ENTRY *entry, const ARENA_INUSE *prev )
+{
+    HEAP_LFH *lfh = heap->lfh;
+    NTSTATUS status = STATUS_NO_MORE_ENTRIES;
+    const ARENA_INUSE *arena;
+    LFH_GROUP *group;
+    DWORD i = 0, j = 0;
+
+    RtlAcquireSRWLockExclusive( &lfh->lock );
+    if (prev)
+    {
+        i = ((const char *)prev - lfh->base) / HEAP_LFH_GROUP_SIZE;
+        if (i < lfh->next_group && lfh->group_used[i])
+        {
+            group = (LFH_GROUP *)(lfh->base + (SIZE_T)i * HEAP_LFH_GROUP_SIZE);
+            j = ((const char *)prev - (const char *)get_lfh_group_block( group, 0 )) /
+                (sizeof(ARENA_INUSE) + group->block_size) + 1;
+        }
+        else j = ~0u;
+    }
+
+    for (; i < lfh->next_group; i++, j = 0)
+    {
+        if (!lfh->group_used[i]) continue;
+        group = (LFH_GROUP *)(lfh->base + (SIZE_T)i * HEAP_LFH_GROUP_SIZE);
+        RtlAcquireSRWLockShared( &group->bin->lock );
+        if (j < group->next_unused)
+        {
+            arena = get_lfh_group_block( group, j );
+            entry->lpData = (void *)(arena + 1);
+            entry->cbData = arena->size;
+            entry->cbOverhead = sizeof(ARENA_INUSE);
+            entry->wFlags = (arena->magic == ARENA_LFH_MAGIC) ? PROCESS_HEAP_ENTRY_BUSY :
+                            PROCESS_HEAP_UNCOMMITTED_RANGE;
+            entry->iRegionIndex = list_count( &heap->subheap_list );
+            status = STATUS_SUCCESS;
+        }
+        RtlReleaseSRWLockShared( &group->bin->lock );
+        if (!status) break;
+    }
+    RtlReleaseSRWLockExclusive( &lfh->lock );
+    return status;
+}
+
+
+/***********************************************************************
+ *           get_thread_cache
+ *
+ * The cache pointer is kept in the TEB Reserved5[1] slot, which is reserved for it.
+ * Reserved5[0] holds the pthread TEB on macOS x86_64 (see alloc_tls_slot).
+ */
+static inline HEAP_THREAD_CACHE *get_thread_cache(void)
+{
+    return NtCurrentTeb()->Reserved5[1];
+}
+
+
+/***********************************************************************
+ *           allocate_cached_block
+ *
+ * Allocate a small block from the current thread cache, without any locking.
+ */
+static void *allocate_cached_block( DWORD flags, SIZE_T size )
+{
+    HEAP_THREAD_CACHE *cache = get_thread_cache();
+    unsigned int index = get_lfh_bin_index( size );
+    ARENA_INUSE *arena;
+
+    if (!cache || index >= HEAP_CACHE_NB_BINS) return NULL;
+
+    RtlAcquireSRWLockExclusive( &cache->lock );
+    if (!cache->count[index])
+    {
+        RtlReleaseSRWLockExclusive( &cache->lock );
+        return NULL;
+    }
+    arena = cache->blocks[index][--cache->count[index]];
+    arena->magic = ARENA_LFH_MAGIC;
+    RtlReleaseSRWLockExclusive( &cache->lock );
+
+    arena->unused_bytes = arena->size - size;
+    notify_alloc( arena + 1, size, flags & HEAP_ZERO_MEMORY );
+    initialize_block( arena + 1, size, arena->unused_bytes, flags );
+    return arena + 1;
+}
+
+
+/***********************************************************************
+ *           flush_cached_blocks
+ *
+ * Return the oldest cached blocks of a bin to their groups. The cache lock must be held.
+ */
+static void flush_cached_blocks( HEAP *heap, HEAP_THREAD_CACHE *cache, unsigned int index, DWORD count )
+{
+    ARENA_INUSE *arena;
+    LFH_GROUP *group;
+    DWORD i;
+
+    for (i = 0; i < count; i++)
+    {
+        arena = cache->blocks[index][i];
+        group = find_lfh_group( heap, arena );
+        RtlAcquireSRWLockExclusive( &group->bin->lock );
+        if (!put_lfh_block( group, arena ))
+        {
+            RtlReleaseSRWLockExclusive( &group->bin->lock );
+            continue;
+        }
+        RtlReleaseSRWLockExclusive( &group->bin->lock );
+        release_lfh_group( heap, group );
+    }
+    cache->count[index] -= count;
+    memmove( cache->blocks[index], cache->blocks[index] + count,
+             cache->count[index] * sizeof(*cache->blocks[index]) );
+}
+
+
+/***********************************************************************
+ *           free_cached_block
+ *
+ * Put a small LFH block in the current thread cache. Returns FALSE if the
+ * block can't be cached, in which case it should be freed normally.
+ */
+static BOOL free_cached_block( HEAP *heap, void *ptr )
+{
+    HEAP_THREAD_CACHE *cache = get_thread_cache();
+    ARENA_INUSE *arena = (ARENA_INUSE *)ptr - 1;
+    LFH_GROUP *group;
+    unsigned int index;
+
+    /* invalid pointers and double frees are reported by free_lfh_block */
+    if (!(group = find_lfh_group( heap, arena )) || group->magic != LFH_GROUP_MAGIC) return FALSE;
+    if (arena->magic != ARENA_LFH_MAGIC) return FALSE;
+    if ((index = get_lfh_bin_index( group->block_size - ARENA_OFFSET )) >= HEAP_CACHE_NB_BINS)
+        return FALSE;
+
+    if (!cache)
+    {
+        if (!(cache = RtlAllocateHeap( heap, HEAP_ZERO_MEMORY, sizeof(*cache) ))) return FALSE;
+        RtlInitializeSRWLock( &cache->lock );
+        RtlAcquireSRWLockExclusive( &thread_caches_lock );
+        list_add_tail( &thread_caches, &cache->entry );
+        RtlReleaseSRWLockExclusive( &thread_caches_lock );
+        NtCurrentTeb()->Reserved5[1] = cache;
+    }
+
+    RtlAcquireSRWLockExclusive( &cache->lock );
+    if (cache->count[index] == HEAP_CACHE_DEPTH)
+        flush_cached_blocks( heap, cache, index, HEAP_CACHE_DEPTH / 2 );
+    arena->magic = ARENA_LFH_FREE_MAGIC;
+    cache->blocks[index][cache->count[index]++] = arena;
+    RtlReleaseSRWLockExclusive( &cache->lock );
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           flush_thread_cache
+ */
+static void flush_thread_cache( HEAP *heap, HEAP_THREAD_CACHE *cache )
+{
+    unsigned int i;
+
+    RtlAcquireSRWLockExclusive( &cache->lock );
+    for (i = 0; i < HEAP_CACHE_NB_BINS; i++)
+        if (cache->count[i]) flush_cached_blocks( heap, cache, i, cache->count[i] );
+    RtlReleaseSRWLockExclusive( &cache->lock );
+}
+
+
+/***********************************************************************
+ *           heap_flush_thread_caches
+ *
+ * Return the blocks cached by all the threads to the process heap.
+ */
+static void heap_flush_thread_caches( HEAP *heap )
+{
+    HEAP_THREAD_CACHE *cache;
+
+    RtlAcquireSRWLockShared( &thread_caches_lock );
+    LIST_FOR_EACH_ENTRY( cache, &thread_caches, HEAP_THREAD_CACHE, entry )
+        flush_thread_cache( heap, cache );
+    RtlReleaseSRWLockShared( &thread_caches_lock );
+}
+
+
+/***********************************************************************
+ *           heap_thread_detach
+ *
+ * Release the process heap cache of the current thread.
+ */
+void heap_thread_detach(void)
+{
+    HEAP_THREAD_CACHE *cache = get_thread_cache();
+
+    if (!cache) return;
+    RtlAcquireSRWLockExclusive( &thread_caches_lock );
+    list_remove( &cache->entry );
+    RtlReleaseSRWLockExclusive( &thread_caches_lock );
+    flush_thread_cache( processHeap, cache );
+    NtCurrentTeb()->Reserved5[1] = NULL;
+    RtlFreeHeap( processHeap, 0, cache );
+}
+
+
+/***********************************************************************
+ *           heap_enable_lfh
+ */
+static NTSTATUS heap_enable_lfh( HEAP *heap )
+{
+    HEAP_LFH *lfh;
+    void *addr = NULL;
+    SIZE_T size, nb_groups = HEAP_LFH_RESERVE_SIZE / HEAP_LFH_GROUP_SIZE;
+    unsigned int i, j;
+    NTSTATUS status;
+
+    if (heap->lfh) return STATUS_SUCCESS;
+    if (!(heap->flags & HEAP_GROWABLE) || RUNNING_ON_VALGRIND ||
+        (heap->flags & (HEAP_NO_SERIALIZE | HEAP_SHARED | HEAP_PAGE_ALLOCS | HEAP_VALIDATE |
+                        HEAP_TAIL_CHECKING_ENABLED | HEAP_FREE_CHECKING_ENABLED)))
+        return STATUS_UNSUCCESSFUL;
+
+    size = sizeof(*lfh) + nb_groups * (sizeof(*lfh->free_groups) + sizeof(*lfh->group_used));
+    if ((status = NtAllocateVirtualMemory( NtCurrentProcess(), &addr, 0, &size, MEM_COMMIT,
+                                           PAGE_READWRITE )))
+        return status;
+    lfh = addr;
+    lfh->free_groups = (DWORD *)(lfh + 1);
+    lfh->group_used  = (BYTE *)(lfh->free_groups + nb_groups);
+    lfh->nb_groups   = nb_groups;
+
+    addr = NULL;
+    lfh->size = HEAP_LFH_RESERVE_SIZE;
+    if ((status = NtAllocateVirtualMemory( NtCurrentProcess(), &addr, 0, &lfh->size, MEM_RESERVE,
+                                           get_protection_type( heap->flags ) )))
+    {
+        size = 0;
+        addr = lfh;
+        NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+        return status;
+    }
+    lfh->base = addr;
+
+    for (i = 0; i < HEAP_LFH_AFFINITY_SLOTS; i++)
+    {
+        for (j = 0; j < HEAP_LFH_NB_BINS; j++)
+        {
+            list_init( &lfh->bins[i][j].groups );
+            lfh->bins[i][j].block_size = get_lfh_bin_size( j ) + ARENA_OFFSET;
+        }
+    }
+
+    InterlockedExchangePointer( (void **)&heap->lfh, lfh );
+    return STATUS_SUCCESS;
+}
+
+
+/***********************************************************************
+ *           heap_destroy_lfh
+ */
+static void heap_destroy_lfh( HEAP *heap )
+{
+    SIZE_T size = 0;
+    void *addr;
+
+    if (!heap->lfh) return;
+    addr = heap->lfh->base;
+    NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+    size = 0;
+    addr = heap->lfh;
+    NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+    heap->lfh = NULL;
+}
+
+
 /***********************************************************************
  *           HEAP_CreateSubHeap
  */
@@ -924,6 +1621,7 @@ static SUBHEAP *HEAP_CreateSubHeap( HEAP *heap, LPVOID address, DWORD flags,
         heap->flags         = flags;
         heap->magic         = HEAP_MAGIC;
         heap->grow_size     = max( HEAP_DEF_SIZE, totalSize );
+        heap->lfh           = NULL;
         list_init( &heap->subheap_list );
         list_init( &heap->large_list );
 
@@ -1344,8 +2042,9 @@ static BOOL HEAP_IsRealArena( HEAP *heapPtr,   /* [in] ptr to the heap */
     {
         const ARENA_INUSE *arena = (const ARENA_INUSE *)block - 1;
 
-        if (!(subheap = HEAP_FindSubHeap( heapPtr, arena )) ||
-            ((const char *)arena < (char *)subheap->base + subheap->headerSize))
+        if (is_lfh_block( heapPtr, arena )) ret = validate_lfh_block( heapPtr, arena, quiet );
+        else if (!(subheap = HEAP_FindSubHeap( heapPtr, arena )) ||
+                 ((const char *)arena < (char *)subheap->base + subheap->headerSize))
         {
             if (!(large_arena = find_large_block( heapPtr, block )))
             {
@@ -1381,6 +2080,8 @@ static BOOL HEAP_IsRealArena( HEAP *heapPtr,   /* [in] ptr to the heap */
     LIST_FOR_EACH_ENTRY( large_arena, &heapPtr->large_list, ARENA_LARGE, entry )
         if (!validate_large_arena( heapPtr, large_arena, quiet )) goto done;
 
+    if (heapPtr->lfh && !validate_lfh_groups( heapPtr )) goto done;
+
     ret = TRUE;
 
 done:
@@ -1561,6 +2262,8 @@ HANDLE WINAPI RtlCreateHeap( ULONG flags, PVOID addr, SIZE_T totalSize, SIZE_T c
     {
         processHeap = subheap->heap;  /* assume the first heap we create is the process main heap */
         list_init( &processHeap->entry );
+        /* like Windows, use the low-fragmentation heap unless debugging flags are set */
+        heap_enable_lfh( processHeap );
     }
 
     return subheap->heap;
@@ -1606,6 +2309,8 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE heap )
     heapPtr->critSection.DebugInfo->Spare[0] = 0;
     RtlDeleteCriticalSection( &heapPtr->critSection );
 
+    heap_destroy_lfh( heapPtr );
+
     LIST_FOR_EACH_ENTRY_SAFE( arena, arena_next, &heapPtr->large_list, ARENA_LARGE, entry )
     {
         list_remove( &arena->entry );
@@ -1669,6 +2374,20 @@ void * WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_
     }
     if (rounded_size < HEAP_MIN_DATA_SIZE) rounded_size = HEAP_MIN_DATA_SIZE;
 
+    if (heapPtr->lfh && size <= HEAP_LFH_MAX_SIZE)
+    {
+        void *ret = NULL;
+
+        if (heapPtr == processHeap) ret = allocate_cached_block( flags, size );
+        if (!ret) ret = allocate_lfh_block( heapPtr, flags, size );
+        if (ret)
+        {
+            TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, ret );
+            return ret;
+        }
+        /* fall back to the standard heap when out of groups */
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) enter_critical_section( &heapPtr->critSection );
 
     if (rounded_size >= HEAP_MIN_LARGE_BLOCK_SIZE && (flags & HEAP_GROWABLE))
@@ -1750,6 +2469,24 @@ BOOLEAN WINAPI DECLSPEC_HOTPATCH RtlFreeHeap( HANDLE heap, ULONG flags, void *pt
         return FALSE;
     }
 
+    if (is_lfh_block( heapPtr, (ARENA_INUSE *)ptr - 1 ))
+    {
+        notify_free( ptr );
+        if (heapPtr == processHeap && free_cached_block( heapPtr, ptr ))
+        {
+            TRACE("(%p,%08x,%p): returning TRUE\n", heap, flags, ptr );
+            return TRUE;
+        }
+        if (!free_lfh_block( heapPtr, ptr ))
+        {
+            RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_INVALID_PARAMETER );
+            TRACE("(%p,%08x,%p): returning FALSE\n", heap, flags, ptr );
+            return FALSE;
+        }
+        TRACE("(%p,%08x,%p): returning TRUE\n", heap, flags, ptr );
+        return TRUE;
+    }
+
     flags &= HEAP_NO_SERIALIZE;
     flags |= heapPtr->flags;
     if (!(flags & HEAP_NO_SERIALIZE)) enter_critical_section( &heapPtr->critSection );
@@ -1813,6 +2550,24 @@ PVOID WINAPI RtlReAllocateHeap( HANDLE heap, ULONG flags, PVOID ptr, SIZE_T size
     flags &= HEAP_GENERATE_EXCEPTIONS | HEAP_NO_SERIALIZE | HEAP_ZERO_MEMORY |
              HEAP_REALLOC_IN_PLACE_ONLY;
     flags |= heapPtr->flags;
+
+    if (is_lfh_block( heapPtr, (ARENA_INUSE *)ptr - 1 ))
+    {
+        if (!validate_lfh_block( heapPtr, (ARENA_INUSE *)ptr - 1, QUIET ))
+        {
+            RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_INVALID_PARAMETER );
+            TRACE("(%p,%08x,%p,%08lx): returning NULL\n", heap, flags, ptr, size );
+            return NULL;
+        }
+        if (!(ret = realloc_lfh_block( heapPtr, flags, ptr, size )))
+        {
+            if (flags & HEAP_GENERATE_EXCEPTIONS) RtlRaiseStatus( STATUS_NO_MEMORY );
+            RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_NO_MEMORY );
+        }
+        TRACE("(%p,%08x,%p,%08lx): returning %p\n", heap, flags, ptr, size, ret );
+        return ret;
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) enter_critical_section( &heapPtr->critSection );
 
     rounded_size = ROUND_SIZE(size) + HEAP_TAIL_EXTRA_SIZE(flags);
@@ -1944,6 +2699,9 @@ error:
 ULONG WINAPI RtlCompactHeap( HANDLE heap, ULONG flags )
 {
     static BOOL reported;
+    HEAP *heapPtr = HEAP_GetPtr( heap );
+
+    if (heapPtr && heapPtr == processHeap && heapPtr->lfh) heap_flush_thread_caches( heapPtr );
     if (!reported++) FIXME( "(%p, 0x%x) stub\n", heap, flags );
     return 0;
 }
@@ -2020,11 +2778,23 @@ SIZE_T WINAPI RtlSizeHeap( HANDLE heap, ULONG flags, const void *ptr )
         RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_INVALID_HANDLE );
         return ~(SIZE_T)0;
     }
+    pArena = (const ARENA_INUSE *)ptr - 1;
+    if (is_lfh_block( heapPtr, pArena ))
+    {
+        if (!validate_lfh_block( heapPtr, pArena, QUIET ))
+        {
+            RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_INVALID_PARAMETER );
+            ret = ~(SIZE_T)0;
+        }
+        else ret = pArena->size - pArena->unused_bytes;
+        TRACE("(%p,%08x,%p): returning %08lx\n", heap, flags, ptr, ret );
+        return ret;
+    }
+
     flags &= HEAP_NO_SERIALIZE;
     flags |= heapPtr->flags;
     if (!(flags & HEAP_NO_SERIALIZE)) enter_critical_section( &heapPtr->critSection );
 
-    pArena = (const ARENA_INUSE *)ptr - 1;
     if (!validate_block_pointer( heapPtr, &subheap, pArena ))
     {
         RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_INVALID_PARAMETER );
@@ -2064,6 +2834,7 @@ BOOLEAN WINAPI RtlValidateHeap( HANDLE heap, ULONG flags, LPCVOID ptr )
 {
     HEAP *heapPtr = HEAP_GetPtr( heap );
     if (!heapPtr) return FALSE;
+    if (heapPtr == processHeap && heapPtr->lfh) heap_flush_thread_caches( heapPtr );
     return HEAP_IsRealArena( heapPtr, flags, ptr, QUIET );
 }
 
@@ -2098,6 +2869,12 @@ NTSTATUS WINAPI RtlWalkHeap( HANDLE heap, PVOID entry_ptr )
         currentheap = &heapPtr->subheap;
         ptr = (char*)currentheap->base + currentheap->headerSize;
     }
+    else if (is_lfh_block( heapPtr, (ARENA_INUSE *)entry->lpData - 1 ))
+    {
+        if ((ret = walk_lfh_blocks( heapPtr, entry, (ARENA_INUSE *)entry->lpData - 1 )))
+            TRACE("end reached.\n");
+        goto HW_end;
+    }
     else
     {
         ptr = entry->lpData;
@@ -2136,9 +2913,9 @@ NTSTATUS WINAPI RtlWalkHeap( HANDLE heap, PVOID entry_ptr )
         {   /* proceed with next subheap */
             struct list *next = list_next( &heapPtr->subheap_list, &currentheap->entry );
             if (!next)
-            {  /* successfully finished */
-                TRACE("end reached.\n");
-                ret = STATUS_NO_MORE_ENTRIES;
+            {  /* proceed with the low-fragmentation heap blocks, if any */
+                ret = heapPtr->lfh ? walk_lfh_blocks( heapPtr, entry, NULL ) : STATUS_NO_MORE_ENTRIES;
+                if (ret) TRACE("end reached.\n");
                 goto HW_end;
             }
             currentheap = LIST_ENTRY( next, SUBHEAP, entry );
@@ -2232,6 +3009,8 @@ ULONG WINAPI RtlGetProcessHeaps( ULONG count, HANDLE *heaps )
 NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class,
                                          PVOID info, SIZE_T size_in, PSIZE_T size_out)
 {
+    HEAP *heapPtr;
+
     switch (info_class)
     {
     case HeapCompatibilityInformation:
@@ -2240,7 +3019,8 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
         if (size_in < sizeof(ULONG))
             return STATUS_BUFFER_TOO_SMALL;
 
-        *(ULONG *)info = 0; /* standard heap */
+        heapPtr = HEAP_GetPtr( heap );
+        *(ULONG *)info = heapPtr && heapPtr->lfh ? 2 : 0; /* low-fragmentation or standard heap */
         return STATUS_SUCCESS;
 
     default:
@@ -2254,6 +3034,27 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
  */
 NTSTATUS WINAPI RtlSetHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class, PVOID info, SIZE_T size)
 {
-    FIXME("%p %d %p %ld stub\n", heap, info_class, info, size);
-    return STATUS_SUCCESS;
+    HEAP *heapPtr;
+    NTSTATUS status;
+
+    switch (info_class)
+    {
+    case HeapCompatibilityInformation:
+        if (size < sizeof(ULONG)) return STATUS_BUFFER_TOO_SMALL;
+        if (!info) return STATUS_ACCESS_VIOLATION;
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+        if (*(ULONG *)info != 2)
+        {
+            FIXME("%p: unsupported compatibility mode %u\n", heap, *(ULONG *)info);
+            return STATUS_SUCCESS;
+        }
+        enter_critical_section( &heapPtr->critSection );
+        status = heap_enable_lfh( heapPtr );
+        leave_critical_section( &heapPtr->critSection );
+        return status;
+
+    default:
+        FIXME("%p %d %p %ld stub\n", heap, info_class, info, size);
+        return STATUS_SUCCESS;
+    }
 }
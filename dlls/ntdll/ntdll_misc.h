@@ -164,4 +164,7 @@ static inline void ascii_to_unicode( WCHAR *dst, const char *src, size_t len )
 /* FLS data */
 extern TEB_FLS_DATA *fls_alloc_data(void) DECLSPEC_HIDDEN;
 
+/* heap */
+extern void heap_thread_detach(void) DECLSPEC_HIDDEN;
+
 #endif
@@ -2225,10 +2225,7 @@ static void test_query_process_handlecount(void)
 
     /* Check if we have some return values */
     if (winetest_debug > 1) trace("HandleCount : %ld\n", handlecount);
-    todo_wine
-    {
-        ok( handlecount > 0, "Expected some handles, got 0\n");
-    }
+    ok( handlecount > 0, "Expected some handles, got 0\n");
 }
 
 static void test_query_process_image_file_name(void)
@@ -208,7 +208,6 @@ static NTSTATUS get_object( HANDLE handle, struct esync **obj )
     NTSTATUS ret = STATUS_SUCCESS;
     enum esync_type type = 0;
     unsigned int shm_idx = 0;
-    obj_handle_t fd_handle;
     sigset_t sigset;
     int fd = -1;
 
@@ -238,8 +237,7 @@ static NTSTATUS get_object( HANDLE handle, struct esync **obj )
             {
                 type = reply->type;
                 shm_idx = reply->shm_idx;
-                fd = receive_fd( &fd_handle );
-                assert( wine_server_ptr_handle(fd_handle) == handle );
+                fd = receive_handle_fd( wine_server_obj_handle(handle) );
             }
         }
         SERVER_END_REQ;
@@ -289,7 +287,6 @@ static NTSTATUS create_esync( enum esync_type type, HANDLE *handle, ACCESS_MASK
     NTSTATUS ret;
     data_size_t len;
     struct object_attributes *objattr;
-    obj_handle_t fd_handle;
     unsigned int shm_idx;
     sigset_t sigset;
     int fd;
@@ -312,8 +309,7 @@ static NTSTATUS create_esync( enum esync_type type, HANDLE *handle, ACCESS_MASK
             *handle = wine_server_ptr_handle( reply->handle );
             type = reply->type;
             shm_idx = reply->shm_idx;
-            fd = receive_fd( &fd_handle );
-            assert( wine_server_ptr_handle(fd_handle) == *handle );
+            fd = receive_handle_fd( wine_server_obj_handle(*handle) );
         }
     }
     SERVER_END_REQ;
@@ -333,7 +329,6 @@ static NTSTATUS open_esync( enum esync_type type, HANDLE *handle,
     ACCESS_MASK access, const OBJECT_ATTRIBUTES *attr )
 {
     NTSTATUS ret;
-    obj_handle_t fd_handle;
     unsigned int shm_idx;
     sigset_t sigset;
     int fd;
@@ -352,8 +347,7 @@ static NTSTATUS open_esync( enum esync_type type, HANDLE *handle,
             *handle = wine_server_ptr_handle( reply->handle );
             type = reply->type;
             shm_idx = reply->shm_idx;
-            fd = receive_fd( &fd_handle );
-            assert( wine_server_ptr_handle(fd_handle) == *handle );
+            fd = receive_handle_fd( wine_server_obj_handle(*handle) );
         }
     }
     SERVER_END_REQ;
@@ -819,7 +813,6 @@ static NTSTATUS __esync_wait_objects( DWORD count, const HANDLE *handles, BOOLEA
     /* Grab the APC fd if we don't already have it. */
     if (alertable && ntdll_get_thread_data()->esync_apc_fd == -1)
     {
-        obj_handle_t fd_handle;
         sigset_t sigset;
         int fd = -1;
 
@@ -828,8 +821,7 @@ static NTSTATUS __esync_wait_objects( DWORD count, const HANDLE *handles, BOOLEA
         {
             if (!(ret = wine_server_call( req )))
             {
-                fd = receive_fd( &fd_handle );
-                assert( fd_handle == GetCurrentThreadId() );
+                fd = receive_handle_fd( GetCurrentThreadId() );
             }
         }
         SERVER_END_REQ;
@@ -1014,6 +1006,12 @@ static NTSTATUS __esync_wait_objects( DWORD count, const HANDLE *handles, BOOLEA
                         return STATUS_INVALID_HANDLE;
                     }
 
+                    /* Only try the objects that poll() reported as signaled;
+                     * reading every fd in the set would cost a syscall per
+                     * handle on each wakeup. If one of the others became
+                     * signaled since, the next poll() returns immediately. */
+                    if (!(fds[i].revents & POLLIN)) continue;
+
                     if (obj)
                     {
                         if (obj->type == ESYNC_MANUAL_EVENT
@@ -1021,11 +1019,8 @@ static NTSTATUS __esync_wait_objects( DWORD count, const HANDLE *handles, BOOLEA
                                 || obj->type == ESYNC_QUEUE)
                         {
                             /* Don't grab the object, just check if it's signaled. */
-                            if (fds[i].revents & POLLIN)
-                            {
-                                TRACE("Woken up by handle %p [%d].\n", handles[i], i);
-                                return i;
-                            }
+                            TRACE("Woken up by handle %p [%d].\n", handles[i], i);
+                            return i;
                         }
                         else
                         {
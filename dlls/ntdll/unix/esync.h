@@ -59,3 +59,4 @@ extern NTSTATUS esync_signal_and_wait( HANDLE signal, HANDLE wait, BOOLEAN alert
 extern pthread_mutex_t fd_cache_mutex;
 
 extern int receive_fd( obj_handle_t *handle ) DECLSPEC_HIDDEN;
+extern int receive_handle_fd( obj_handle_t handle ) DECLSPEC_HIDDEN;
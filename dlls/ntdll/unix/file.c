@@ -51,6 +51,7 @@
 #endif
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <sys/ioctl.h>
 #ifdef HAVE_SYS_ATTR_H
 #include <sys/attr.h>
@@ -225,6 +226,7 @@ struct dir_data
     unsigned int            count;   /* count of used entries in the names array */
     unsigned int            pos;     /* current reading position in the names array */
     struct file_identity    id;      /* directory file identity */
+    BOOL                    no_xattr; /* the file system doesn't support extended attributes */
     struct dir_data_names  *names;   /* directory file names */
     struct dir_data_buffer *buffer;  /* head of data buffers list */
 };
@@ -290,6 +292,12 @@ static inline BOOL is_ignored_file( const struct stat *st )
     return FALSE;
 }
 
+/* check if a Unix name is "." or ".." */
+static inline BOOL is_dot_name( const char *name )
+{
+    return name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]));
+}
+
 static inline unsigned int dir_info_align( unsigned int len )
 {
     return (len + 7) & ~7;
@@ -1678,8 +1686,11 @@ NTSTATUS fd_set_file_info( int fd, ULONG attr )
     return STATUS_SUCCESS;
 }
 
-/* get the stat info and file attributes for a file (by name) */
-static int get_file_info( const char *path, struct stat *st, ULONG *attr )
+/* get the stat info and file attributes for a file (by name), parent is the identity of
+ * the parent directory if known, no_xattr caches the lack of extended attributes support
+ * on the parent file system */
+static int get_file_info_in_dir( const char *path, const struct file_identity *parent, BOOL *no_xattr,
+                                 struct stat *st, ULONG *attr )
 {
     char *parent_path;
     char hexattr[11];
@@ -1702,6 +1713,11 @@ static int get_file_info( const char *path, struct stat *st, ULONG *attr )
         if (get_symlink_properties( AT_FDCWD, path, NULL, NULL, NULL, NULL, &is_dir ) == STATUS_SUCCESS)
             st->st_mode = (st->st_mode & ~S_IFMT) | (is_dir ? S_IFDIR : S_IFREG);
     }
+    else if (S_ISDIR( st->st_mode ) && parent)
+    {
+        if (st->st_dev != parent->dev || st->st_ino == parent->ino)
+            *attr |= FILE_ATTRIBUTE_REPARSE_POINT;
+    }
     else if (S_ISDIR( st->st_mode ) && (parent_path = malloc( strlen(path) + 4 )))
     {
         struct stat parent_st;
@@ -1717,7 +1733,11 @@ static int get_file_info( const char *path, struct stat *st, ULONG *attr )
     }
     *attr |= get_file_attributes( st );
     /* retrieve any stored DOS attributes */
-    len = xattr_get( path, SAMBA_XATTR_DOS_ATTRIB, hexattr, sizeof(hexattr)-1 );
+    if (!parent || st->st_dev != parent->dev) no_xattr = NULL;  /* may be another file system */
+    if (no_xattr && *no_xattr) len = -1;
+    else if ((len = xattr_get( path, SAMBA_XATTR_DOS_ATTRIB, hexattr, sizeof(hexattr)-1 )) == -1 &&
+             no_xattr && (errno == EOPNOTSUPP || errno == ENOSYS))
+        *no_xattr = TRUE;
     if (len == -1)
     {
         /* convert Unix-style hidden files to a DOS hidden file attribute */
@@ -1729,6 +1749,12 @@ static int get_file_info( const char *path, struct stat *st, ULONG *attr )
     return ret;
 }
 
+/* get the stat info and file attributes for a file (by name) */
+static int get_file_info( const char *path, struct stat *st, ULONG *attr )
+{
+    return get_file_info_in_dir( path, NULL, NULL, st, attr );
+}
+
 
 #if defined(__ANDROID__) && !defined(HAVE_UTIMENSAT)
 static int utimensat( int fd, const char *name, const struct timespec spec[2], int flags )
@@ -2239,7 +2265,17 @@ static NTSTATUS get_dir_data_entry( struct dir_data *dir_data, void *info_ptr, I
     struct stat st;
     ULONG name_len, start, dir_size, attributes;
 
-    if (get_file_info( names->unix_name, &st, &attributes ) == -1)
+    if (class == FileNamesInformation && !ignored_files_count)
+    {
+        /* only the name is needed, so don't bother with the attributes */
+        if (lstat( names->unix_name, &st ) == -1)
+        {
+            TRACE( "file no longer exists %s\n", names->unix_name );
+            return STATUS_SUCCESS;
+        }
+    }
+    else if (get_file_info_in_dir( names->unix_name, is_dot_name( names->unix_name ) ? NULL : &dir_data->id,
+                                   &dir_data->no_xattr, &st, &attributes ) == -1)
     {
         TRACE( "file no longer exists %s\n", names->unix_name );
         return STATUS_SUCCESS;
@@ -2469,6 +2505,368 @@ done:
 }
 
 
+/* Process-wide cache of the entries of the most recently scanned directories,
+ * so that repeated case-insensitive lookups, and especially lookups of missing
+ * files, as well as NtQueryDirectoryFile calls on any handle, don't need to
+ * scan them again. A cached directory is dropped as soon as its modification
+ * time changes. Directories modified less than a second before the scan are
+ * not cached, since a change made during the scan might not update the time
+ * stamp. */
+
+#define DIR_CACHE_DIRS 8        /* number of cached directories */
+#define DIR_CACHE_MAX  0x20000  /* max number of names in a cached directory */
+
+struct dir_cache_entry
+{
+    unsigned int hash;          /* hash of the case-folded name */
+    unsigned int offset : 31;   /* offset of the unix name in the names buffer, plus one; 0 if free */
+    unsigned int is_short : 1;  /* hash of the generated short name */
+};
+
+struct dir_cache
+{
+    dev_t                   dev;          /* device and inode of the directory */
+    ino_t                   ino;
+    struct timespec         mtime;        /* modification time when it was scanned */
+    unsigned int            count;        /* number of used hash table entries */
+    unsigned int            size;         /* size of the hash table, a power of 2 */
+    int                     short_names;  /* 1 if short names were added, -1 if that failed */
+    char                   *names;        /* null-terminated unix names */
+    unsigned int            names_len;
+    unsigned int            names_size;
+    struct dir_cache_entry *table;
+    struct dir_data        *data;         /* unfiltered contents for NtQueryDirectoryFile, built on first use */
+};
+
+static struct dir_cache *dir_cache[DIR_CACHE_DIRS];  /* most recently used first */
+static pthread_mutex_t dir_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* fold case with the same table as ntdll_wcsnicmp(), which is used to match the names */
+static unsigned int hash_dir_name( const WCHAR *name, int length )
+{
+    unsigned int hash = 0;
+    int i;
+
+    for (i = 0; i < length; i++) hash = hash * 31 + ntdll_towupper( name[i] );
+    return hash;
+}
+
+/* get the modification time of a directory, with the nanoseconds if available */
+static void get_dir_mtime( const struct stat *st, struct timespec *mtime )
+{
+    mtime->tv_sec = st->st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    mtime->tv_nsec = st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    mtime->tv_nsec = st->st_mtimespec.tv_nsec;
+#else
+    mtime->tv_nsec = 0;
+#endif
+}
+
+/* check if a directory wasn't modified too recently to be cached */
+static inline BOOL is_dir_cacheable( const struct stat *st )
+{
+    return st->st_mtime < time( NULL ) - 1;
+}
+
+static void free_dir_cache( struct dir_cache *cache )
+{
+    if (!cache) return;
+    free_dir_data( cache->data );
+    free( cache->names );
+    free( cache->table );
+    free( cache );
+}
+
+static BOOL grow_dir_cache( struct dir_cache *cache )
+{
+    unsigned int i, j, size = cache->size ? cache->size * 2 : 256;
+    struct dir_cache_entry *table;
+
+    if (!(table = calloc( size, sizeof(*table) ))) return FALSE;
+    for (i = 0; i < cache->size; i++)
+    {
+        if (!cache->table[i].offset) continue;
+        for (j = cache->table[i].hash & (size - 1); table[j].offset; j = (j + 1) & (size - 1)) ;
+        table[j] = cache->table[i];
+    }
+    free( cache->table );
+    cache->table = table;
+    cache->size  = size;
+    return TRUE;
+}
+
+static struct dir_cache *alloc_dir_cache( const struct stat *st )
+{
+    struct dir_cache *cache;
+
+    if (!(cache = calloc( 1, sizeof(*cache) ))) return NULL;
+    cache->dev   = st->st_dev;
+    cache->ino   = st->st_ino;
+    get_dir_mtime( st, &cache->mtime );
+    if (grow_dir_cache( cache )) return cache;
+    free( cache );
+    return NULL;
+}
+
+static BOOL add_dir_cache_entry( struct dir_cache *cache, unsigned int hash, unsigned int offset, BOOL is_short )
+{
+    unsigned int i;
+
+    if (cache->count * 2 >= cache->size && !grow_dir_cache( cache )) return FALSE;
+    for (i = hash & (cache->size - 1); cache->table[i].offset; i = (i + 1) & (cache->size - 1)) ;
+    cache->table[i].hash     = hash;
+    cache->table[i].offset   = offset + 1;
+    cache->table[i].is_short = is_short;
+    cache->count++;
+    return TRUE;
+}
+
+/* add a directory entry to a cache being built */
+static BOOL add_dir_cache_name( struct dir_cache *cache, const char *unix_name, const WCHAR *name, int length )
+{
+    unsigned int len = strlen( unix_name ) + 1;
+
+    if (cache->count >= DIR_CACHE_MAX) return FALSE;
+    if (cache->names_len + len > cache->names_size)
+    {
+        unsigned int size = max( cache->names_size * 2, 4096 );
+        char *names;
+
+        if (!(names = realloc( cache->names, size ))) return FALSE;
+        cache->names = names;
+        cache->names_size = size;
+    }
+    if (!add_dir_cache_entry( cache, hash_dir_name( name, length ), cache->names_len, FALSE )) return FALSE;
+    memcpy( cache->names + cache->names_len, unix_name, len );
+    cache->names_len += len;
+    return TRUE;
+}
+
+/* add the generated short names of the entries that are not valid 8.3 names */
+static void add_dir_cache_short_names( struct dir_cache *cache )
+{
+    WCHAR buffer[MAX_DIR_ENTRY_LEN], short_nameW[12];
+    unsigned int pos, len;
+    int ret;
+
+    for (pos = 0; pos < cache->names_len; pos += len + 1)
+    {
+        len = strlen( cache->names + pos );
+        ret = ntdll_umbstowcs( cache->names + pos, len, buffer, MAX_DIR_ENTRY_LEN );
+        if (is_legal_8dot3_name( buffer, ret )) continue;
+        ret = hash_short_file_name( buffer, ret, short_nameW );
+        if (!add_dir_cache_entry( cache, hash_dir_name( short_nameW, ret ), pos, TRUE ))
+        {
+            cache->short_names = -1;
+            return;
+        }
+    }
+    cache->short_names = 1;
+}
+
+/* find a name in a cached directory, return its unix name */
+static const char *find_dir_cache_name( const struct dir_cache *cache, const WCHAR *name, int length )
+{
+    WCHAR buffer[MAX_DIR_ENTRY_LEN], short_nameW[12];
+    unsigned int i, hash = hash_dir_name( name, length );
+    const char *unix_name;
+    int ret;
+
+    for (i = hash & (cache->size - 1); cache->table[i].offset; i = (i + 1) & (cache->size - 1))
+    {
+        if (cache->table[i].hash != hash) continue;
+        unix_name = cache->names + cache->table[i].offset - 1;
+        ret = ntdll_umbstowcs( unix_name, strlen(unix_name), buffer, MAX_DIR_ENTRY_LEN );
+        if (cache->table[i].is_short)
+        {
+            ret = hash_short_file_name( buffer, ret, short_nameW );
+            if (ret == length && !wcsnicmp( short_nameW, name, length )) return unix_name;
+        }
+        else if (ret == length && !wcsnicmp( buffer, name, length )) return unix_name;
+    }
+    return NULL;
+}
+
+/* remove a directory from the cache, the mutex must be held */
+static void remove_dir_cache( unsigned int index )
+{
+    free_dir_cache( dir_cache[index] );
+    memmove( dir_cache + index, dir_cache + index + 1, (DIR_CACHE_DIRS - index - 1) * sizeof(*dir_cache) );
+    dir_cache[DIR_CACHE_DIRS - 1] = NULL;
+}
+
+/* find the cache of a directory and make it the most recently used one, the mutex must be held */
+static struct dir_cache *find_dir_cache( const struct stat *st )
+{
+    struct dir_cache *cache;
+    struct timespec mtime;
+    unsigned int i;
+
+    for (i = 0; i < DIR_CACHE_DIRS && (cache = dir_cache[i]); i++)
+    {
+        if (cache->dev != st->st_dev || cache->ino != st->st_ino) continue;
+        get_dir_mtime( st, &mtime );
+        if (cache->mtime.tv_sec != mtime.tv_sec || cache->mtime.tv_nsec != mtime.tv_nsec)
+        {
+            remove_dir_cache( i );  /* the directory changed */
+            return NULL;
+        }
+        memmove( dir_cache + 1, dir_cache, i * sizeof(*dir_cache) );
+        dir_cache[0] = cache;
+        return cache;
+    }
+    return NULL;
+}
+
+/* copy the cached entries of a directory that match the mask, the cache must be owned or locked */
+static NTSTATUS copy_dir_cache_data( struct dir_data *data, struct dir_cache *cache, const UNICODE_STRING *mask )
+{
+    const struct dir_data_names *names;
+    unsigned int i, pos, len;
+
+    if (!cache->data)
+    {
+        /* "." and ".." come first, as with read_directory_data_readdir() */
+        if (!(cache->data = calloc( 1, sizeof(*cache->data) ))) return STATUS_NO_MEMORY;
+        if (!append_entry( cache->data, ".", NULL, NULL )) goto failed;
+        if (!append_entry( cache->data, "..", NULL, NULL )) goto failed;
+        for (pos = 0; pos < cache->names_len; pos += len + 1)
+        {
+            len = strlen( cache->names + pos );
+            if (!strcmp( cache->names + pos, "." ) || !strcmp( cache->names + pos, ".." )) continue;
+            if (!append_entry( cache->data, cache->names + pos, NULL, NULL )) goto failed;
+        }
+    }
+
+    for (i = 0; i < cache->data->count; i++)
+    {
+        names = &cache->data->names[i];
+        if (mask && !match_filename( names->long_name, wcslen( names->long_name ), mask ))
+        {
+            if (!names->short_name[0]) continue;  /* no short name to match */
+            if (!match_filename( names->short_name, wcslen( names->short_name ), mask )) continue;
+        }
+        if (!add_dir_data_names( data, names->long_name, names->short_name, names->unix_name ))
+            return STATUS_NO_MEMORY;
+    }
+    return STATUS_SUCCESS;
+
+failed:
+    free_dir_data( cache->data );
+    cache->data = NULL;
+    return STATUS_NO_MEMORY;
+}
+
+/***********************************************************************
+ *           lookup_dir_cache
+ *
+ * Look for a name in the cached entries of a directory. unix_name is the
+ * directory path, the entry name is appended to it at pos on success.
+ * Return STATUS_MORE_ENTRIES if the directory needs to be scanned.
+ */
+static NTSTATUS lookup_dir_cache( char *unix_name, int pos, const struct stat *st,
+                                  const WCHAR *name, int length, BOOLEAN check_short )
+{
+    NTSTATUS status = STATUS_MORE_ENTRIES;
+    struct dir_cache *cache;
+    const char *found = NULL;
+
+    mutex_lock( &dir_cache_mutex );
+    if ((cache = find_dir_cache( st )))
+    {
+        if (!(found = find_dir_cache_name( cache, name, length )) && check_short)
+        {
+            if (!cache->short_names) add_dir_cache_short_names( cache );
+            if (cache->short_names > 0) found = find_dir_cache_name( cache, name, length );
+        }
+        if (found)
+        {
+            unix_name[pos - 1] = '/';
+            strcpy( unix_name + pos, found );
+            status = STATUS_SUCCESS;
+        }
+        else if (!check_short || cache->short_names > 0) status = STATUS_OBJECT_PATH_NOT_FOUND;
+    }
+    mutex_unlock( &dir_cache_mutex );
+    return status;
+}
+
+/* store the entries of a fully scanned directory in the cache */
+static void store_dir_cache( struct dir_cache *cache )
+{
+    unsigned int i;
+
+    mutex_lock( &dir_cache_mutex );
+    for (i = 0; i < DIR_CACHE_DIRS && dir_cache[i]; i++)
+    {
+        if (dir_cache[i]->dev != cache->dev || dir_cache[i]->ino != cache->ino) continue;
+        remove_dir_cache( i );
+        break;
+    }
+    free_dir_cache( dir_cache[DIR_CACHE_DIRS - 1] );
+    memmove( dir_cache + 1, dir_cache, (DIR_CACHE_DIRS - 1) * sizeof(*dir_cache) );
+    dir_cache[0] = cache;
+    mutex_unlock( &dir_cache_mutex );
+}
+
+
+/***********************************************************************
+ *           read_directory_data_cache
+ *
+ * Read a directory from the process-wide cache of its contents, scanning
+ * it with readdir first if necessary; helper for NtQueryDirectoryFile.
+ */
+static NTSTATUS read_directory_data_cache( struct dir_data *data, int fd, const UNICODE_STRING *mask )
+{
+    struct dir_cache *cache;
+    struct dirent *de;
+    struct stat st;
+    NTSTATUS status;
+    DIR *dir;
+
+    if (fstat( fd, &st ) == -1) return read_directory_data_readdir( data, mask );
+
+    mutex_lock( &dir_cache_mutex );
+    if ((cache = find_dir_cache( &st )))
+    {
+        TRACE( "using cached directory contents\n" );
+        status = copy_dir_cache_data( data, cache, mask );
+        mutex_unlock( &dir_cache_mutex );
+        return status;
+    }
+    mutex_unlock( &dir_cache_mutex );
+
+    if (!is_dir_cacheable( &st ) || !(cache = alloc_dir_cache( &st )))
+        return read_directory_data_readdir( data, mask );
+
+    if (!(dir = opendir( "." )))
+    {
+        free_dir_cache( cache );
+        return STATUS_NO_SUCH_FILE;
+    }
+    while ((de = readdir( dir )))
+    {
+        WCHAR buffer[MAX_DIR_ENTRY_LEN];
+        int ret = ntdll_umbstowcs( de->d_name, strlen(de->d_name), buffer, MAX_DIR_ENTRY_LEN );
+
+        if (!add_dir_cache_name( cache, de->d_name, buffer, ret ))
+        {
+            free_dir_cache( cache );
+            closedir( dir );
+            return read_directory_data_readdir( data, mask );
+        }
+    }
+    closedir( dir );
+
+    status = copy_dir_cache_data( data, cache, mask );
+    if (cache->data) store_dir_cache( cache );
+    else free_dir_cache( cache );
+    return status;
+}
+
+
 /***********************************************************************
  *           read_directory_data
  *
@@ -2498,7 +2896,7 @@ static NTSTATUS read_directory_data( struct dir_data *data, int fd, const UNICOD
         }
     }
 
-    return read_directory_data_readdir( data, mask );
+    return read_directory_data_cache( data, fd, mask );
 }
 
 
@@ -2716,6 +3114,8 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
 {
     WCHAR buffer[MAX_DIR_ENTRY_LEN];
     BOOLEAN is_name_8_dot_3;
+    struct dir_cache *cache = NULL;
+    const char *found = NULL;
     DIR *dir;
     struct dirent *de;
     struct stat st;
@@ -2794,17 +3194,44 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
     }
 #endif /* VFAT_IOCTL_READDIR_BOTH */
 
-    if (!(dir = opendir( unix_name ))) return errno_to_status( errno );
+    /* check the entries of recently scanned directories */
 
+    if (!stat( unix_name, &st ))
+    {
+        NTSTATUS status = lookup_dir_cache( unix_name, pos, &st, name, length, is_name_8_dot_3 );
+
+        if (status == STATUS_SUCCESS) return status;
+        if (status == STATUS_OBJECT_PATH_NOT_FOUND) goto not_found;
+        if (is_dir_cacheable( &st )) cache = alloc_dir_cache( &st );
+    }
+
+    if (!(dir = opendir( unix_name )))
+    {
+        free_dir_cache( cache );
+        return errno_to_status( errno );
+    }
+
+    /* when building the cache, keep scanning after a match to get all the entries */
     unix_name[pos - 1] = '/';
     while ((de = readdir( dir )))
     {
         ret = ntdll_umbstowcs( de->d_name, strlen(de->d_name), buffer, MAX_DIR_ENTRY_LEN );
+        if (cache && !add_dir_cache_name( cache, de->d_name, buffer, ret ))
+        {
+            free_dir_cache( cache );
+            cache = NULL;
+        }
+        if (found)
+        {
+            if (!cache) break;
+            continue;
+        }
+
         if (ret == length && !wcsnicmp( buffer, name, ret ))
         {
             strcpy( unix_name + pos, de->d_name );
-            closedir( dir );
-            return STATUS_SUCCESS;
+            found = unix_name + pos;
+            continue;
         }
 
         if (!is_name_8_dot_3) continue;
@@ -2816,12 +3243,13 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
             if (ret == length && !wcsnicmp( short_nameW, name, length ))
             {
                 strcpy( unix_name + pos, de->d_name );
-                closedir( dir );
-                return STATUS_SUCCESS;
+                found = unix_name + pos;
             }
         }
     }
     closedir( dir );
+    if (cache) store_dir_cache( cache );
+    if (found) return STATUS_SUCCESS;
 
 not_found:
     unix_name[pos - 1] = 0;
@@ -3969,6 +4397,9 @@ NTSTATUS open_unix_file( HANDLE *handle, const char *unix_name, ACCESS_MASK acce
     struct object_attributes *objattr;
     NTSTATUS status;
     data_size_t len;
+    enum server_fd_type type = FD_TYPE_INVALID;
+    unsigned int fd_access = 0, fd_options = 0;
+    sigset_t sigset;
 
     if ((status = alloc_object_attributes( attr, &objattr, &len ))) return status;
 
@@ -3983,8 +4414,19 @@ NTSTATUS open_unix_file( HANDLE *handle, const char *unix_name, ACCESS_MASK acce
         wine_server_add_data( req, unix_name, strlen(unix_name) );
         status = wine_server_call( req );
         *handle = wine_server_ptr_handle( reply->handle );
+        type = reply->type;
+        fd_access = reply->access;
+        fd_options = reply->options;
     }
     SERVER_END_REQ;
+
+    /* the server pushed the unix fd along with the new handle */
+    if (type != FD_TYPE_INVALID)
+    {
+        server_enter_uninterrupted_section( &fd_cache_mutex, &sigset );
+        server_receive_cached_fd( *handle, type, fd_access, fd_options );
+        server_leave_uninterrupted_section( &fd_cache_mutex, &sigset );
+    }
     free( objattr );
     return status;
 }
@@ -5566,6 +6008,26 @@ err:
 }
 
 
+/* maximum number of segments transferred with a single system call */
+#define MAX_SEGMENT_IOV 64
+
+/* build the iovec array for the remaining data of a page segments list */
+static int get_segments_iovec( struct iovec *iov, const FILE_SEGMENT_ELEMENT *segments,
+                               ULONG pos, ULONG length )
+{
+    int count;
+
+    for (count = 0; length && count < MAX_SEGMENT_IOV; count++)
+    {
+        iov[count].iov_base = (char *)segments[count].Buffer + pos;
+        iov[count].iov_len  = min( length, page_size - pos );
+        length -= iov[count].iov_len;
+        pos = 0;
+    }
+    return count;
+}
+
+
 /******************************************************************************
  *              NtReadFileScatter   (NTDLL.@)
  */
@@ -5600,11 +6062,17 @@ NTSTATUS WINAPI NtReadFileScatter( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
 
     while (length)
     {
+        struct iovec iov[MAX_SEGMENT_IOV];
+        int count = get_segments_iovec( iov, segments, pos, length );
+
         if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
-            result = pread( unix_handle, (char *)segments->Buffer + pos,
-                            min( length - pos, page_size - pos ), offset->QuadPart + total );
+#ifdef HAVE_PREADV
+            result = preadv( unix_handle, iov, count, offset->QuadPart + total );
+#else
+            result = pread( unix_handle, iov[0].iov_base, iov[0].iov_len, offset->QuadPart + total );
+#endif
         else
-            result = read( unix_handle, (char *)segments->Buffer + pos, min( length - pos, page_size - pos ) );
+            result = readv( unix_handle, iov, count );
 
         if (result == -1)
         {
@@ -5615,11 +6083,9 @@ NTSTATUS WINAPI NtReadFileScatter( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
         if (!result) break;
         total += result;
         length -= result;
-        if ((pos += result) == page_size)
-        {
-            pos = 0;
-            segments++;
-        }
+        pos += result;
+        segments += pos / page_size;
+        pos %= page_size;
     }
 
     if (total == 0) status = STATUS_END_OF_FILE;
@@ -5903,11 +6369,17 @@ NTSTATUS WINAPI NtWriteFileGather( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
 
     while (length)
     {
+        struct iovec iov[MAX_SEGMENT_IOV];
+        int count = get_segments_iovec( iov, segments, pos, length );
+
         if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
-            result = pwrite( unix_handle, (char *)segments->Buffer + pos,
-                             page_size - pos, offset->QuadPart + total );
+#ifdef HAVE_PWRITEV
+            result = pwritev( unix_handle, iov, count, offset->QuadPart + total );
+#else
+            result = pwrite( unix_handle, iov[0].iov_base, iov[0].iov_len, offset->QuadPart + total );
+#endif
         else
-            result = write( unix_handle, (char *)segments->Buffer + pos, page_size - pos );
+            result = writev( unix_handle, iov, count );
 
         if (result == -1)
         {
@@ -5927,11 +6399,9 @@ NTSTATUS WINAPI NtWriteFileGather( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
         }
         total += result;
         length -= result;
-        if ((pos += result) == page_size)
-        {
-            pos = 0;
-            segments++;
-        }
+        pos += result;
+        segments += pos / page_size;
+        pos %= page_size;
     }
 
     send_completion = cvalue != 0;
@@ -1373,10 +1373,18 @@ NTSTATUS WINAPI NtQueryInformationProcess( HANDLE handle, PROCESSINFOCLASS class
             else if (!handle) ret = STATUS_INVALID_HANDLE;
             else
             {
-                memset(info, 0, 4);
-                len = 4;
+                SERVER_START_REQ( get_handle_table_stats )
+                {
+                    req->handle = wine_server_obj_handle( handle );
+                    if (!(ret = wine_server_call( req )))
+                    {
+                        *(ULONG *)info = reply->used;
+                        len = 4;
+                    }
+                }
+                SERVER_END_REQ;
             }
-            if (size > 4) ret = STATUS_INFO_LENGTH_MISMATCH;
+            if (size > 4 && !ret) ret = STATUS_INFO_LENGTH_MISMATCH;
         }
         else
         {
@@ -267,12 +267,39 @@ static void read_reply_data( void *buffer, size_t size )
  *           wait_reply
  *
  * Wait for a reply from the server.
+ * The reply header and variable-size data are read with a single readv in
+ * the common case, since the server writes them with a single writev.
  */
 static inline unsigned int wait_reply( struct __server_request_info *req )
 {
-    read_reply_data( &req->u.reply, sizeof(req->u.reply) );
-    if (req->u.reply.reply_header.reply_size)
-        read_reply_data( req->reply_data, req->u.reply.reply_header.reply_size );
+    data_size_t max_size = req->u.req.request_header.reply_size;
+    struct iovec vec[2];
+    size_t got;
+    int ret;
+
+    vec[0].iov_base = &req->u.reply;
+    vec[0].iov_len  = sizeof(req->u.reply);
+    vec[1].iov_base = req->reply_data;
+    vec[1].iov_len  = max_size;
+
+    for (;;)
+    {
+        if ((ret = readv( ntdll_get_thread_data()->reply_fd, vec, max_size ? 2 : 1 )) > 0) break;
+        if (!ret) abort_thread(0);
+        if (errno == EINTR) continue;
+        if (errno == EPIPE) abort_thread(0);
+        server_protocol_perror("read");
+    }
+
+    if (ret < sizeof(req->u.reply))
+    {
+        read_reply_data( (char *)&req->u.reply + ret, sizeof(req->u.reply) - ret );
+        got = 0;
+    }
+    else got = ret - sizeof(req->u.reply);
+
+    if (req->u.reply.reply_header.reply_size > got)
+        read_reply_data( (char *)req->reply_data + got, req->u.reply.reply_header.reply_size - got );
     return req->u.reply.reply_header.error;
 }
 
@@ -891,6 +918,59 @@ int receive_fd( obj_handle_t *handle )
 }
 
 
+/* fds pushed along with new handles and received by another thread than their owner */
+static struct pending_fd
+{
+    obj_handle_t handle;
+    int          fd;
+} *pending_fds;
+static unsigned int pending_fds_count, pending_fds_size;
+
+/***********************************************************************
+ *           receive_handle_fd
+ *
+ * Receive the fd sent by the server for the specified handle. Fds pushed
+ * along with handles created by other threads are set aside for them.
+ * Caller must hold fd_cache_mutex.
+ */
+int receive_handle_fd( obj_handle_t handle )
+{
+    obj_handle_t fd_handle;
+    unsigned int i;
+    int fd;
+
+    if (handle & SERVER_PUSHED_FD_FLAG)
+    {
+        for (i = 0; i < pending_fds_count; i++)
+        {
+            if (pending_fds[i].handle != handle) continue;
+            fd = pending_fds[i].fd;
+            pending_fds[i] = pending_fds[--pending_fds_count];
+            return fd;
+        }
+    }
+
+    for (;;)
+    {
+        fd = receive_fd( &fd_handle );
+        if (fd_handle == handle) return fd;
+        assert( fd_handle & SERVER_PUSHED_FD_FLAG );
+        if (pending_fds_count == pending_fds_size)
+        {
+            unsigned int new_size = max( 16, pending_fds_size * 2 );
+            struct pending_fd *new_fds = realloc( pending_fds, new_size * sizeof(*new_fds) );
+
+            if (!new_fds) fatal_error( "out of memory for pending fds\n" );
+            pending_fds = new_fds;
+            pending_fds_size = new_size;
+        }
+        pending_fds[pending_fds_count].handle = fd_handle;
+        pending_fds[pending_fds_count].fd = fd;
+        pending_fds_count++;
+    }
+}
+
+
 /***********************************************************************/
 /* fd cache support */
 
@@ -1001,11 +1081,45 @@ static int remove_fd_from_cache( HANDLE handle )
         cache.data = interlocked_xchg64( &fd_cache[entry][idx].data, 0 );
         if (cache.s.type != FD_TYPE_INVALID) fd = cache.s.fd - 1;
     }
+    clear_sock_state_serial( handle );
 
     return fd;
 }
 
 
+/***********************************************************************
+ *           cache_new_handle_fd
+ *
+ * Cache the fd of a newly allocated handle, replacing any stale entry.
+ * Caller must hold fd_cache_mutex.
+ */
+static void cache_new_handle_fd( HANDLE handle, int fd, enum server_fd_type type,
+                                 unsigned int access, unsigned int options )
+{
+    int stale = remove_fd_from_cache( handle );
+
+    if (stale != -1) close( stale );
+    if (!add_fd_to_cache( handle, fd, type, access, options )) close( fd );
+}
+
+
+/***********************************************************************
+ *           server_receive_cached_fd
+ *
+ * Receive the fd that the server pushed along with a new handle, and cache it.
+ * Caller must hold fd_cache_mutex, but doesn't need to across the request
+ * that created the handle.
+ */
+void server_receive_cached_fd( HANDLE handle, enum server_fd_type type, unsigned int access,
+                               unsigned int options )
+{
+    int fd;
+
+    if ((fd = receive_handle_fd( wine_server_obj_handle(handle) | SERVER_PUSHED_FD_FLAG )) == -1) return;
+    cache_new_handle_fd( handle, fd, type, access, options );
+}
+
+
 /***********************************************************************
  *           server_get_unix_fd
  *
@@ -1015,7 +1129,6 @@ int server_get_unix_fd( HANDLE handle, unsigned int wanted_access, int *unix_fd,
                         int *needs_close, enum server_fd_type *type, unsigned int *options )
 {
     sigset_t sigset;
-    obj_handle_t fd_handle;
     int ret, fd = -1;
     unsigned int access = 0;
 
@@ -1038,9 +1151,8 @@ int server_get_unix_fd( HANDLE handle, unsigned int wanted_access, int *unix_fd,
                 if (type) *type = reply->type;
                 if (options) *options = reply->options;
                 access = reply->access;
-                if ((fd = receive_fd( &fd_handle )) != -1)
+                if ((fd = receive_handle_fd( wine_server_obj_handle(handle) )) != -1)
                 {
-                    assert( wine_server_ptr_handle(fd_handle) == handle );
                     *needs_close = (!reply->cacheable ||
                                     !add_fd_to_cache( handle, fd, reply->type,
                                                       reply->access, reply->options ));
@@ -1673,7 +1785,9 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source, HANDLE
 {
     sigset_t sigset;
     NTSTATUS ret;
-    int fd = -1;
+    enum server_fd_type type;
+    unsigned int fd_access, fd_options;
+    int fd = -1, cached_fd = -1;
 
     if (dest) *dest = 0;
 
@@ -1700,6 +1814,12 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source, HANDLE
 
     server_enter_uninterrupted_section( &fd_cache_mutex, &sigset );
 
+    /* a duplicate in the same process with the same access can share the cached fd */
+    if (source_process == NtCurrentProcess() && dest_process == NtCurrentProcess() &&
+        (options & DUPLICATE_SAME_ACCESS) && dest &&
+        get_cached_fd( source, &cached_fd, &type, &fd_access, &fd_options ))
+        cached_fd = -1;
+
     /* always remove the cached fd; if the server request fails we'll just
      * retrieve it again */
     if (options & DUPLICATE_CLOSE_SOURCE)
@@ -1720,6 +1840,20 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source, HANDLE
     }
     SERVER_END_REQ;
 
+    if (!ret && cached_fd != -1)
+    {
+        if (fd != -1)  /* the source is closed, move its fd to the new handle */
+        {
+            cache_new_handle_fd( *dest, fd, type, fd_access, fd_options );
+            fd = -1;
+        }
+        else if ((cached_fd = dup( cached_fd )) != -1)
+        {
+            fcntl( cached_fd, F_SETFD, FD_CLOEXEC );
+            cache_new_handle_fd( *dest, cached_fd, type, fd_access, fd_options );
+        }
+    }
+
     server_leave_uninterrupted_section( &fd_cache_mutex, &sigset );
 
     if (fd != -1) close( fd );
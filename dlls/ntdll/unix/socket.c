@@ -27,7 +27,11 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <unistd.h>
+#ifdef HAVE_SYS_SENDFILE_H
+# include <sys/sendfile.h>
+#endif
 #ifdef HAVE_IFADDRS_H
 # include <ifaddrs.h>
 #endif
@@ -142,6 +146,7 @@ struct async_transmit_ioctl
     unsigned int buffer_cursor; /* amount of data currently in the buffer already sent */
     unsigned int tail_cursor;   /* amount of tail data already sent */
     unsigned int file_len;      /* total file length to send */
+    BOOL use_sendfile;          /* send the file data with sendfile() instead of the buffer */
     DWORD flags;
     const char *head;
     const char *tail;
@@ -566,6 +571,71 @@ static int wow64_translate_control( const WSABUF *control64, struct afd_wsabuf_3
     return 1;
 }
 
+/* state of the sockets published by the server, indexed by the low bits of their serial */
+static const volatile unsigned int *sock_state;
+
+/* serial of the published state of the recently used socket handles, with the handle in the low bits */
+#define SOCK_STATE_CACHE_SIZE 1024
+static LONG64 sock_state_cache[SOCK_STATE_CACHE_SIZE];
+
+static void map_sock_state(void)
+{
+    static const WCHAR nameW[] = {'\\','K','e','r','n','e','l','O','b','j','e','c','t','s',
+                                  '\\','_','_','w','i','n','e','_','s','o','c','k','e','t','_','s','t','a','t','e',0};
+    UNICODE_STRING name_str = { sizeof(nameW) - sizeof(WCHAR), sizeof(nameW), (WCHAR *)nameW };
+    OBJECT_ATTRIBUTES attr = { sizeof(attr), 0, &name_str };
+    size_t size = SOCK_STATE_SLOTS * sizeof(*sock_state);
+    int fd, needs_close;
+    HANDLE section;
+    void *ptr;
+
+    if (NtOpenSection( &section, SECTION_MAP_READ, &attr )) return;
+    if (!server_get_unix_fd( section, 0, &fd, &needs_close, NULL, NULL ))
+    {
+        if ((ptr = mmap( NULL, size, PROT_READ, MAP_SHARED, fd, 0 )) != MAP_FAILED &&
+            InterlockedCompareExchangePointer( (void **)&sock_state, ptr, NULL ))
+            munmap( ptr, size );  /* another thread mapped it already */
+        if (needs_close) close( fd );
+    }
+    NtClose( section );
+}
+
+/* remember the serial of the published state of a socket, returned by the server */
+static void set_sock_state_serial( HANDLE handle, unsigned int serial )
+{
+    obj_handle_t obj = wine_server_obj_handle( handle );
+    LONG64 *entry = &sock_state_cache[(obj >> 2) % SOCK_STATE_CACHE_SIZE];
+    LONG64 value = (LONG64)serial << 32 | obj, old;
+
+    if (!serial) return;
+    if (!sock_state) map_sock_state();
+    do old = *entry; while (InterlockedCompareExchange64( entry, value, old ) != old);
+}
+
+/* forget the published state of a socket handle, when it's closed or its fd is no longer cached, */
+/* since the handle value may be reused for another socket */
+void clear_sock_state_serial( HANDLE handle )
+{
+    obj_handle_t obj = wine_server_obj_handle( handle );
+    LONG64 *entry = &sock_state_cache[(obj >> 2) % SOCK_STATE_CACHE_SIZE];
+    LONG64 old = *entry;
+
+    if ((obj_handle_t)old == obj) InterlockedCompareExchange64( entry, 0, old );
+}
+
+/* check if the server published that synchronous I/O may be done before calling it, */
+/* that is when no asyncs are queued and the socket isn't shut down */
+static BOOL can_try_sock_io( HANDLE handle, unsigned int flag )
+{
+    obj_handle_t obj = wine_server_obj_handle( handle );
+    LONG64 value = InterlockedCompareExchange64( &sock_state_cache[(obj >> 2) % SOCK_STATE_CACHE_SIZE], 0, 0 );
+    unsigned int serial = value >> 32, state;
+
+    if (!sock_state || !serial || (obj_handle_t)value != obj) return FALSE;
+    state = sock_state[serial % SOCK_STATE_SLOTS];
+    return (state >> SOCK_STATE_SERIAL_SHIFT) == serial && (state & flag);
+}
+
 static NTSTATUS try_recv( int fd, struct async_recv_ioctl *async, ULONG_PTR *size )
 {
 #ifndef HAVE_STRUCT_MSGHDR_MSG_ACCRIGHTS
@@ -686,6 +756,7 @@ static NTSTATUS sock_recv( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, voi
     NTSTATUS status;
     unsigned int i;
     ULONG options;
+    unsigned int serial;
     BOOL nonblocking, alerted;
 
     if (unix_flags & MSG_OOB)
@@ -737,18 +808,34 @@ static NTSTATUS sock_recv( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, voi
         }
     }
 
+    /* For synchronous calls, try to receive right away if nothing is queued
+     * before us; the server then only needs to record the result, which saves
+     * a set_async_direct_result call. */
+    status = STATUS_PENDING;
+    information = 0;
+    if (!force_async && can_try_sock_io( handle, SOCK_STATE_DIRECT_RECV ))
+    {
+        status = try_recv( fd, async, &information );
+        if (status == STATUS_DEVICE_NOT_READY) status = STATUS_PENDING;
+    }
+
     SERVER_START_REQ( recv_socket )
     {
         req->force_async = force_async;
         req->async  = server_async( handle, &async->io, event, apc, apc_user, iosb_client_ptr(io) );
         req->oob    = !!(unix_flags & MSG_OOB);
+        req->status = status;
+        req->total  = information;
         status = wine_server_call( req );
         wait_handle = wine_server_ptr_handle( reply->wait );
         options     = reply->options;
         nonblocking = reply->nonblocking;
+        serial      = reply->state_serial;
     }
     SERVER_END_REQ;
 
+    set_sock_state_serial( handle, serial );
+
     alerted = status == STATUS_ALERTED;
     if (alerted)
     {
@@ -872,7 +959,7 @@ static NTSTATUS sock_send( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, voi
     HANDLE wait_handle;
     DWORD async_size;
     NTSTATUS status;
-    unsigned int i;
+    unsigned int i, serial;
     ULONG options;
     BOOL nonblocking, alerted;
 
@@ -908,17 +995,34 @@ static NTSTATUS sock_send( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, voi
     async->iov_cursor = 0;
     async->sent_len = 0;
 
+    /* For synchronous calls, try to send right away if nothing is queued
+     * before us; the server then only needs to record the result, which saves
+     * a set_async_direct_result call. After a short write, the server either
+     * completes the request (for nonblocking sockets) or lets us continue from
+     * where we stopped. */
+    status = STATUS_PENDING;
+    if (!force_async && can_try_sock_io( handle, SOCK_STATE_DIRECT_SEND ))
+    {
+        status = try_send( fd, async );
+        if (status == STATUS_DEVICE_NOT_READY) status = STATUS_PENDING;
+    }
+
     SERVER_START_REQ( send_socket )
     {
         req->force_async = force_async;
         req->async  = server_async( handle, &async->io, event, apc, apc_user, iosb_client_ptr(io) );
+        req->status = status;
+        req->total  = async->sent_len;
         status = wine_server_call( req );
         wait_handle = wine_server_ptr_handle( reply->wait );
         options     = reply->options;
         nonblocking = reply->nonblocking;
+        serial      = reply->state_serial;
     }
     SERVER_END_REQ;
 
+    set_sock_state_serial( handle, serial );
+
     alerted = status == STATUS_ALERTED;
     if (alerted)
     {
@@ -959,6 +1063,54 @@ static ssize_t do_send( int fd, const void *buffer, size_t len, int flags )
     return ret;
 }
 
+#ifdef HAVE_SYS_SENDFILE_H
+/* send the file data directly from the file to the socket, without going through the buffer */
+static NTSTATUS try_sendfile( int sock_fd, int file_fd, struct async_transmit_ioctl *async )
+{
+    ssize_t ret;
+
+    for (;;)
+    {
+        size_t count = 0x7ffff000; /* maximum that sendfile() transfers at once */
+        off_t offset;
+
+        if (async->file_len)
+        {
+            if (async->file_cursor == async->file_len) break;
+            count = min( count, async->file_len - async->file_cursor );
+        }
+
+        TRACE( "sending up to %zu bytes of file data\n", count );
+        do
+        {
+            if (async->offset.QuadPart == FILE_USE_FILE_POINTER_POSITION)
+                ret = sendfile( sock_fd, file_fd, NULL, count );
+            else
+            {
+                offset = async->offset.QuadPart;
+                ret = sendfile( sock_fd, file_fd, &offset, count );
+            }
+        } while (ret < 0 && errno == EINTR);
+        if (ret < 0)
+        {
+            /* fall back to the buffered path for files that sendfile() doesn't support */
+            if (errno == EINVAL || errno == ENOSYS) return STATUS_NOT_SUPPORTED;
+            if (errno != EWOULDBLOCK) WARN( "sendfile: %s\n", strerror( errno ) );
+            return sock_errno_to_status( errno );
+        }
+        TRACE( "sendfile returned %zd\n", ret );
+        if (!ret) break;  /* end of file */
+
+        async->file_cursor += ret;
+        if (async->offset.QuadPart != FILE_USE_FILE_POINTER_POSITION)
+            async->offset.QuadPart += ret;
+    }
+
+    async->file = NULL;
+    return STATUS_SUCCESS;
+}
+#endif
+
 static NTSTATUS try_transmit( int sock_fd, int file_fd, struct async_transmit_ioctl *async )
 {
     ssize_t ret;
@@ -984,6 +1136,16 @@ static NTSTATUS try_transmit( int sock_fd, int file_fd, struct async_transmit_io
         async->file_cursor += ret;
     }
 
+#ifdef HAVE_SYS_SENDFILE_H
+    if (async->file && async->use_sendfile)
+    {
+        NTSTATUS status = try_sendfile( sock_fd, file_fd, async );
+
+        if (status == STATUS_NOT_SUPPORTED) async->use_sendfile = FALSE;
+        else if (status) return status;
+    }
+#endif
+
     if (async->file && async->buffer_cursor == async->read_len)
     {
         unsigned int read_size = async->buffer_size;
@@ -1104,6 +1266,7 @@ static NTSTATUS sock_transmit( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc,
     async->buffer_cursor = 0;
     async->tail_cursor = 0;
     async->file_len = params->file_len;
+    async->use_sendfile = TRUE;
     async->flags = params->flags;
     async->head = u64_to_user_ptr(params->head_ptr);
     async->head_len = params->head_len;
@@ -1115,6 +1278,7 @@ static NTSTATUS sock_transmit( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc,
     {
         req->force_async = 1;
         req->async  = server_async( handle, &async->io, event, apc, apc_user, iosb_client_ptr(io) );
+        req->status = STATUS_PENDING;
         status = wine_server_call( req );
         wait_handle = wine_server_ptr_handle( reply->wait );
         options     = reply->options;
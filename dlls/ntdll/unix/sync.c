@@ -1899,29 +1899,34 @@ NTSTATUS WINAPI NtRemoveIoCompletion( HANDLE handle, ULONG_PTR *key, ULONG_PTR *
 NTSTATUS WINAPI NtRemoveIoCompletionEx( HANDLE handle, FILE_IO_COMPLETION_INFORMATION *info, ULONG count,
                                         ULONG *written, LARGE_INTEGER *timeout, BOOLEAN alertable )
 {
+    struct completion_info infos[64];
     NTSTATUS status;
-    ULONG i = 0;
+    ULONG i = 0, j, max, size;
 
     TRACE( "%p %p %u %p %p %u\n", handle, info, count, written, timeout, alertable );
 
     for (;;)
     {
+        /* dequeue the entries in batches, each one a single server round trip */
         while (i < count)
         {
-            SERVER_START_REQ( remove_completion )
+            max = min( count - i, ARRAY_SIZE(infos) );
+            SERVER_START_REQ( remove_completions )
             {
                 req->handle = wine_server_obj_handle( handle );
-                if (!(status = wine_server_call( req )))
-                {
-                    info[i].CompletionKey             = reply->ckey;
-                    info[i].CompletionValue           = reply->cvalue;
-                    info[i].IoStatusBlock.Information = reply->information;
-                    info[i].IoStatusBlock.u.Status    = reply->status;
-                }
+                wine_server_set_reply( req, infos, max * sizeof(infos[0]) );
+                if (!(status = wine_server_call( req ))) size = wine_server_reply_size( reply ) / sizeof(infos[0]);
             }
             SERVER_END_REQ;
             if (status != STATUS_SUCCESS) break;
-            ++i;
+            for (j = 0; j < size; j++, i++)
+            {
+                info[i].CompletionKey             = infos[j].ckey;
+                info[i].CompletionValue           = infos[j].cvalue;
+                info[i].IoStatusBlock.Information = infos[j].information;
+                info[i].IoStatusBlock.u.Status    = infos[j].status;
+            }
+            if (size < max) break;  /* the queue is empty */
         }
         if (i || status != STATUS_PENDING)
         {
@@ -63,6 +63,12 @@
 # include <mach/mach_init.h>
 # include <mach/mach_vm.h>
 #endif
+#ifdef HAVE_LINUX_USERFAULTFD_H
+# include <linux/fs.h>
+# include <linux/userfaultfd.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+#endif
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -210,6 +216,13 @@ static const size_t view_block_size = 0x100000;
 static void *preload_reserve_start;
 static void *preload_reserve_end;
 static BOOL force_exec_prot;  /* whether to force PROT_EXEC on all PROT_READ mmaps */
+static BOOL use_kernel_write_watch;  /* whether the kernel tracks the written pages of write watch views */
+
+#if defined(HAVE_LINUX_USERFAULTFD_H) && defined(UFFD_FEATURE_WP_ASYNC) && defined(PAGEMAP_SCAN)
+#define USE_KERNEL_WRITE_WATCH
+static int uffd_fd = -1;     /* userfaultfd used to write-protect the watched pages */
+static int pagemap_fd = -1;  /* /proc/self/pagemap used to scan for the written pages */
+#endif
 
 struct range_entry
 {
@@ -1676,6 +1689,152 @@ static NTSTATUS set_protection( struct file_view *view, void *base, SIZE_T size,
 }
 
 
+#ifdef USE_KERNEL_WRITE_WATCH
+
+/***********************************************************************
+ *           kernel_write_watch_init
+ *
+ * Check for userfaultfd asynchronous write protection and pagemap scanning,
+ * which let the kernel track writes without a page fault for each page.
+ * This is done on the first write watch allocation, so that processes that
+ * don't use write watches don't keep the file descriptors open.
+ * virtual_mutex must be held by caller.
+ */
+static BOOL kernel_write_watch_init(void)
+{
+    const __u64 features = UFFD_FEATURE_WP_ASYNC | UFFD_FEATURE_WP_UNPOPULATED;
+    struct uffdio_api uffdio_api;
+    static BOOL checked;
+
+    if (checked) return use_kernel_write_watch;
+    checked = TRUE;
+
+    if ((uffd_fd = syscall( __NR_userfaultfd, O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY )) == -1) return FALSE;
+
+    uffdio_api.api = UFFD_API;
+    uffdio_api.features = features;
+    if (ioctl( uffd_fd, UFFDIO_API, &uffdio_api ) == -1 || (uffdio_api.features & features) != features ||
+        (pagemap_fd = open( "/proc/self/pagemap", O_RDONLY | O_CLOEXEC )) == -1)
+    {
+        close( uffd_fd );
+        uffd_fd = -1;
+        return FALSE;
+    }
+    TRACE( "using kernel write watches\n" );
+    use_kernel_write_watch = TRUE;
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           kernel_write_watch_reset
+ *
+ * Write-protect a range of pages again, so that the next write marks them as written.
+ */
+static void kernel_write_watch_reset( void *base, size_t size )
+{
+    struct uffdio_writeprotect wp;
+
+    wp.range.start = (UINT_PTR)base;
+    wp.range.len = size;
+    wp.mode = UFFDIO_WRITEPROTECT_MODE_WP;
+    if (ioctl( uffd_fd, UFFDIO_WRITEPROTECT, &wp ) == -1)
+        ERR( "failed to write-protect %p-%p, errno %d\n", base, (char *)base + size, errno );
+}
+
+
+/***********************************************************************
+ *           kernel_write_watch_register
+ *
+ * Let the kernel track the writes to a range of a write watch view.
+ */
+static NTSTATUS kernel_write_watch_register( void *base, size_t size )
+{
+    struct uffdio_register uffdio_register;
+
+    uffdio_register.range.start = (UINT_PTR)base;
+    uffdio_register.range.len = size;
+    uffdio_register.mode = UFFDIO_REGISTER_MODE_WP;
+    if (ioctl( uffd_fd, UFFDIO_REGISTER, &uffdio_register ) == -1)
+    {
+        ERR( "failed to register %p-%p, errno %d\n", base, (char *)base + size, errno );
+        return STATUS_NO_MEMORY;
+    }
+
+    /* the pages don't need to be write-protected by us */
+    set_page_vprot_bits( base, size, 0, VPROT_WRITEWATCH );
+    mprotect_range( base, size, 0, 0 );
+    kernel_write_watch_reset( base, size );
+    return STATUS_SUCCESS;
+}
+
+
+/***********************************************************************
+ *           kernel_get_write_watches
+ *
+ * Retrieve the written pages in a range, and optionally reset them at the same time.
+ */
+static ULONG_PTR kernel_get_write_watches( void *base, size_t size, void **addresses, ULONG_PTR count,
+                                           BOOL reset )
+{
+    struct page_region ranges[16];
+    struct pm_scan_arg arg;
+    ULONG_PTR pos = 0;
+    UINT64 addr;
+    int i, ret;
+
+    memset( &arg, 0, sizeof(arg) );
+    arg.size = sizeof(arg);
+    arg.start = (UINT_PTR)base;
+    arg.end = (UINT_PTR)base + size;
+    arg.vec = (UINT_PTR)ranges;
+    arg.vec_len = ARRAY_SIZE(ranges);
+    arg.flags = PM_SCAN_CHECK_WPASYNC | (reset ? PM_SCAN_WP_MATCHING : 0);
+    arg.category_mask = PAGE_IS_WRITTEN;
+    arg.return_mask = PAGE_IS_WRITTEN;
+
+    while (pos < count && arg.start < arg.end)
+    {
+        arg.max_pages = count - pos;
+        if ((ret = ioctl( pagemap_fd, PAGEMAP_SCAN, &arg )) == -1)
+        {
+            ERR( "failed to scan %p-%p, errno %d\n", base, (char *)base + size, errno );
+            break;
+        }
+        for (i = 0; i < ret; i++)
+            for (addr = ranges[i].start; addr < ranges[i].end && pos < count; addr += page_size)
+                addresses[pos++] = (void *)(UINT_PTR)addr;
+        if (ret < ARRAY_SIZE(ranges)) break;
+        arg.start = arg.walk_end;
+    }
+    return pos;
+}
+
+#else  /* USE_KERNEL_WRITE_WATCH */
+
+static BOOL kernel_write_watch_init(void)
+{
+    return FALSE;
+}
+
+static void kernel_write_watch_reset( void *base, size_t size )
+{
+}
+
+static NTSTATUS kernel_write_watch_register( void *base, size_t size )
+{
+    return STATUS_NOT_SUPPORTED;
+}
+
+static ULONG_PTR kernel_get_write_watches( void *base, size_t size, void **addresses, ULONG_PTR count,
+                                           BOOL reset )
+{
+    return 0;
+}
+
+#endif  /* USE_KERNEL_WRITE_WATCH */
+
+
 /***********************************************************************
  *           update_write_watches
  */
@@ -1696,6 +1855,11 @@ static void update_write_watches( void *base, size_t size, size_t accessed_size
  */
 static void reset_write_watches( void *base, SIZE_T size )
 {
+    if (use_kernel_write_watch)
+    {
+        kernel_write_watch_reset( base, size );
+        return;
+    }
     set_page_vprot_bits( base, size, VPROT_WRITEWATCH, 0 );
     mprotect_range( base, size, 0, 0 );
 }
@@ -2194,6 +2358,14 @@ static SIZE_T get_committed_size( struct file_view *view, void *base, BYTE *vpro
 static NTSTATUS decommit_pages( struct file_view *view, size_t start, size_t size )
 {
     if (!size) size = view->size;
+    if ((view->protect & VPROT_WRITEWATCH) && use_kernel_write_watch)
+    {
+        /* keep the mapping, a new one would have to be registered again */
+        if (madvise( (char *)view->base + start, size, MADV_DONTNEED ) == -1) return STATUS_NO_MEMORY;
+        set_page_vprot_bits( (char *)view->base + start, size, 0, VPROT_COMMITTED );
+        mprotect_range( (char *)view->base + start, size, 0, 0 );
+        return STATUS_SUCCESS;
+    }
     if (anon_mmap_fixed( (char *)view->base + start, size, PROT_NONE, 0 ) != MAP_FAILED)
     {
         set_page_vprot_bits( (char *)view->base + start, size, 0, VPROT_COMMITTED );
@@ -3979,6 +4151,9 @@ NTSTATUS WINAPI NtAllocateVirtualMemory( HANDLE process, PVOID *ret, ULONG_PTR z
             else if (is_dos_memory) status = allocate_dos_memory( &view, vprot );
             else status = map_view( &view, base, size, type & MEM_TOP_DOWN, vprot, zero_bits );
 
+            if (status == STATUS_SUCCESS && (vprot & VPROT_WRITEWATCH) && kernel_write_watch_init() &&
+                (status = kernel_write_watch_register( view->base, view->size )))
+                delete_view( view );
             if (status == STATUS_SUCCESS) base = view->base;
         }
     }
@@ -4927,12 +5102,17 @@ NTSTATUS WINAPI NtGetWriteWatch( HANDLE process, ULONG flags, PVOID base, SIZE_T
         char *addr = base;
         char *end = addr + size;
 
-        while (pos < *count && addr < end)
+        if (use_kernel_write_watch)
+            pos = kernel_get_write_watches( base, size, addresses, *count, flags & WRITE_WATCH_FLAG_RESET );
+        else
         {
-            if (!(get_page_vprot( addr ) & VPROT_WRITEWATCH)) addresses[pos++] = addr;
-            addr += page_size;
+            while (pos < *count && addr < end)
+            {
+                if (!(get_page_vprot( addr ) & VPROT_WRITEWATCH)) addresses[pos++] = addr;
+                addr += page_size;
+            }
+            if (flags & WRITE_WATCH_FLAG_RESET) reset_write_watches( base, addr - (char *)base );
         }
-        if (flags & WRITE_WATCH_FLAG_RESET) reset_write_watches( base, addr - (char *)base );
         *count = pos;
         *granularity = page_size;
     }
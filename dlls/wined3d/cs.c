@@ -24,6 +24,21 @@ WINE_DECLARE_DEBUG_CHANNEL(d3d_sync);
 WINE_DECLARE_DEBUG_CHANNEL(fps);
 
 #define WINED3D_INITIAL_CS_SIZE 4096
+#define WINED3D_DEFERRED_BLOCK_SIZE 0x10000
+#define WINED3D_DEFERRED_BLOCK_POOL_SIZE 64
+
+/* Deferred contexts record into a chain of blocks, which is handed over to
+ * the command list as is. Blocks of the default size are recycled through a
+ * process-wide lock-free pool once the command list is destroyed. */
+struct wined3d_deferred_block
+{
+    SLIST_ENTRY entry;
+    struct wined3d_deferred_block *next;
+    SIZE_T size, capacity;
+    BYTE data[1];
+};
+
+static SLIST_HEADER wined3d_deferred_block_pool;
 
 struct wined3d_deferred_upload
 {
@@ -46,8 +61,7 @@ struct wined3d_command_list
 
     struct wined3d_device *device;
 
-    SIZE_T data_size;
-    void *data;
+    struct wined3d_deferred_block *blocks;
 
     SIZE_T resource_count;
     struct wined3d_resource **resources;
@@ -3350,29 +3364,33 @@ static inline bool wined3d_cs_execute_next(struct wined3d_cs *cs, struct wined3d
 static void wined3d_cs_exec_execute_command_list(struct wined3d_cs *cs, const void *data)
 {
     const struct wined3d_cs_execute_command_list *op = data;
-    SIZE_T start = 0, end = op->list->data_size;
-    const BYTE *cs_data = op->list->data;
+    const struct wined3d_deferred_block *block;
     struct wined3d_cs_queue *queue;
+    SIZE_T start;
 
     TRACE("Executing command list %p.\n", op->list);
 
     queue = &cs->queue[WINED3D_CS_QUEUE_MAP];
-    while (start < end)
+    for (block = op->list->blocks; block; block = block->next)
     {
-        const struct wined3d_cs_packet *packet;
-        enum wined3d_cs_op opcode;
+        start = 0;
+        while (start < block->size)
+        {
+            const struct wined3d_cs_packet *packet;
+            enum wined3d_cs_op opcode;
 
-        while (!wined3d_cs_queue_is_empty(cs, queue))
-            wined3d_cs_execute_next(cs, queue);
+            while (!wined3d_cs_queue_is_empty(cs, queue))
+                wined3d_cs_execute_next(cs, queue);
 
-        packet = wined3d_next_cs_packet(cs_data, &start, WINED3D_CS_QUEUE_MASK);
-        opcode = *(const enum wined3d_cs_op *)packet->data;
+            packet = wined3d_next_cs_packet(block->data, &start, ~(SIZE_T)0);
+            opcode = *(const enum wined3d_cs_op *)packet->data;
 
-        if (opcode >= WINED3D_CS_OP_STOP)
-            ERR("Invalid opcode %#x.\n", opcode);
-        else
-            wined3d_cs_op_handlers[opcode](cs, packet->data);
-        TRACE("%s executed.\n", debug_cs_op(opcode));
+            if (opcode >= WINED3D_CS_OP_STOP)
+                ERR("Invalid opcode %#x.\n", opcode);
+            else
+                wined3d_cs_op_handlers[opcode](cs, packet->data);
+            TRACE("%s executed.\n", debug_cs_op(opcode));
+        }
     }
 }
 
@@ -3995,8 +4013,7 @@ struct wined3d_deferred_context
 {
     struct wined3d_device_context c;
 
-    SIZE_T data_size, data_capacity;
-    void *data;
+    struct wined3d_deferred_block *blocks, *current_block;
 
     SIZE_T resource_count, resources_capacity;
     struct wined3d_resource **resources;
@@ -4022,10 +4039,64 @@ static struct wined3d_deferred_context *wined3d_deferred_context_from_context(st
     return CONTAINING_RECORD(context, struct wined3d_deferred_context, c);
 }
 
+static struct wined3d_deferred_block *wined3d_deferred_block_create(SIZE_T size)
+{
+    struct wined3d_deferred_block *block;
+
+    if (size <= WINED3D_DEFERRED_BLOCK_SIZE
+            && (block = (struct wined3d_deferred_block *)InterlockedPopEntrySList(&wined3d_deferred_block_pool)))
+    {
+        block->next = NULL;
+        block->size = 0;
+        return block;
+    }
+
+    size = max(size, WINED3D_DEFERRED_BLOCK_SIZE);
+    if (!(block = heap_alloc(offsetof(struct wined3d_deferred_block, data[size]))))
+        return NULL;
+    block->next = NULL;
+    block->size = 0;
+    block->capacity = size;
+
+    return block;
+}
+
+static void wined3d_deferred_blocks_destroy(struct wined3d_deferred_block *block)
+{
+    struct wined3d_deferred_block *next;
+
+    for (; block; block = next)
+    {
+        next = block->next;
+        if (block->capacity == WINED3D_DEFERRED_BLOCK_SIZE
+                && QueryDepthSList(&wined3d_deferred_block_pool) < WINED3D_DEFERRED_BLOCK_POOL_SIZE)
+            InterlockedPushEntrySList(&wined3d_deferred_block_pool, &block->entry);
+        else
+            heap_free(block);
+    }
+}
+
+static void wined3d_deferred_blocks_decref_objects(const struct wined3d_deferred_block *block)
+{
+    const struct wined3d_cs_packet *packet;
+    SIZE_T offset;
+
+    for (; block; block = block->next)
+    {
+        offset = 0;
+        while (offset < block->size)
+        {
+            packet = wined3d_next_cs_packet(block->data, &offset, ~(SIZE_T)0);
+            wined3d_cs_packet_decref_objects(packet);
+        }
+    }
+}
+
 static void *wined3d_deferred_context_require_space(struct wined3d_device_context *context,
         size_t size, enum wined3d_cs_queue_id queue_id)
 {
     struct wined3d_deferred_context *deferred = wined3d_deferred_context_from_context(context);
+    struct wined3d_deferred_block *block = deferred->current_block;
     struct wined3d_cs_packet *packet;
     size_t header_size, packet_size;
 
@@ -4036,11 +4107,19 @@ static void *wined3d_deferred_context_require_space(struct wined3d_device_contex
     packet_size = offsetof(struct wined3d_cs_packet, data[size]);
     packet_size = (packet_size + header_size - 1) & ~(header_size - 1);
 
-    if (!wined3d_array_reserve(&deferred->data, &deferred->data_capacity, deferred->data_size + packet_size, 1))
-        return NULL;
+    if (!block || block->capacity - block->size < packet_size)
+    {
+        if (!(block = wined3d_deferred_block_create(packet_size)))
+            return NULL;
+        if (deferred->current_block)
+            deferred->current_block->next = block;
+        else
+            deferred->blocks = block;
+        deferred->current_block = block;
+    }
 
-    packet = (struct wined3d_cs_packet *)((BYTE *)deferred->data + deferred->data_size);
-    TRACE("size was %Iu, adding %Iu\n", (size_t)deferred->data_size, packet_size);
+    packet = (struct wined3d_cs_packet *)&block->data[block->size];
+    TRACE("size was %Iu, adding %Iu\n", (size_t)block->size, packet_size);
     packet->size = packet_size - header_size;
     return &packet->data;
 }
@@ -4048,10 +4127,11 @@ static void *wined3d_deferred_context_require_space(struct wined3d_device_contex
 static void wined3d_deferred_context_submit(struct wined3d_device_context *context, enum wined3d_cs_queue_id queue_id)
 {
     struct wined3d_deferred_context *deferred = wined3d_deferred_context_from_context(context);
+    struct wined3d_deferred_block *block = deferred->current_block;
     struct wined3d_cs_packet *packet;
 
     assert(queue_id == WINED3D_CS_QUEUE_DEFAULT);
-    packet = wined3d_next_cs_packet(deferred->data, &deferred->data_size, ~(SIZE_T)0);
+    packet = wined3d_next_cs_packet(block->data, &block->size, ~(SIZE_T)0);
     wined3d_cs_packet_incref_objects(packet);
 }
 
@@ -4279,8 +4359,7 @@ HRESULT CDECL wined3d_deferred_context_create(struct wined3d_device *device, str
 void CDECL wined3d_deferred_context_destroy(struct wined3d_device_context *context)
 {
     struct wined3d_deferred_context *deferred = wined3d_deferred_context_from_context(context);
-    const struct wined3d_cs_packet *packet;
-    SIZE_T i, offset = 0;
+    SIZE_T i;
 
     TRACE("context %p.\n", context);
 
@@ -4313,14 +4392,10 @@ void CDECL wined3d_deferred_context_destroy(struct wined3d_device_context *conte
         wined3d_query_decref(deferred->queries[i].query);
     heap_free(deferred->queries);
 
-    while (offset < deferred->data_size)
-    {
-        packet = wined3d_next_cs_packet(deferred->data, &offset, ~(SIZE_T)0);
-        wined3d_cs_packet_decref_objects(packet);
-    }
+    wined3d_deferred_blocks_decref_objects(deferred->blocks);
+    wined3d_deferred_blocks_destroy(deferred->blocks);
 
     wined3d_state_destroy(deferred->c.state);
-    heap_free(deferred->data);
     heap_free(deferred);
 }
 
@@ -4337,8 +4412,7 @@ HRESULT CDECL wined3d_deferred_context_record_command_list(struct wined3d_device
     memory = heap_alloc(sizeof(*object) + deferred->resource_count * sizeof(*object->resources)
             + deferred->upload_count * sizeof(*object->uploads)
             + deferred->command_list_count * sizeof(*object->command_lists)
-            + deferred->query_count * sizeof(*object->queries)
-            + deferred->data_size);
+            + deferred->query_count * sizeof(*object->queries));
 
     if (!memory)
     {
@@ -4377,11 +4451,11 @@ HRESULT CDECL wined3d_deferred_context_record_command_list(struct wined3d_device
     memcpy(object->queries, deferred->queries, deferred->query_count * sizeof(*object->queries));
     /* Transfer our references to the queries to the command list. */
 
-    object->data = memory;
-    object->data_size = deferred->data_size;
-    memcpy(object->data, deferred->data, deferred->data_size);
+    /* Transfer the recorded packets to the command list, without copying
+     * them. */
+    object->blocks = deferred->blocks;
+    deferred->blocks = deferred->current_block = NULL;
 
-    deferred->data_size = 0;
     deferred->resource_count = 0;
     deferred->upload_count = 0;
     deferred->command_list_count = 0;
@@ -4423,6 +4497,7 @@ static void wined3d_command_list_destroy_object(void *object)
         }
     }
 
+    wined3d_deferred_blocks_destroy(list->blocks);
     heap_free(list);
 }
 
@@ -4439,8 +4514,7 @@ ULONG CDECL wined3d_command_list_decref(struct wined3d_command_list *list)
 {
     ULONG refcount = InterlockedDecrement(&list->refcount);
     struct wined3d_device *device = list->device;
-    const struct wined3d_cs_packet *packet;
-    SIZE_T i, offset;
+    SIZE_T i;
 
     TRACE("%p decreasing refcount to %u.\n", list, refcount);
 
@@ -4455,12 +4529,7 @@ ULONG CDECL wined3d_command_list_decref(struct wined3d_command_list *list)
         for (i = 0; i < list->query_count; ++i)
             wined3d_query_decref(list->queries[i].query);
 
-        offset = 0;
-        while (offset < list->data_size)
-        {
-            packet = wined3d_next_cs_packet(list->data, &offset, ~(SIZE_T)0);
-            wined3d_cs_packet_decref_objects(packet);
-        }
+        wined3d_deferred_blocks_decref_objects(list->blocks);
 
         wined3d_mutex_lock();
         wined3d_cs_destroy_object(device->cs, wined3d_command_list_destroy_object, list);
@@ -70,12 +70,26 @@ struct shader_spirv_graphics_program_variant_vk
     VkShaderModule vk_module;
 };
 
+struct shader_spirv_compile_job
+{
+    TP_WORK *work;
+    struct wined3d_shader *shader;
+    struct vkd3d_shader_scan_descriptor_info *descriptor_info;
+
+    /* Compute shaders only. */
+    struct shader_spirv_resource_bindings bindings;
+    struct vkd3d_shader_code spirv;
+    bool cached;
+    int ret;
+};
+
 struct shader_spirv_graphics_program_vk
 {
     struct shader_spirv_graphics_program_variant_vk *variants;
     SIZE_T variants_size, variant_count;
 
     struct vkd3d_shader_scan_descriptor_info descriptor_info;
+    struct shader_spirv_compile_job *job;
 };
 
 struct shader_spirv_compute_program_vk
@@ -86,6 +100,7 @@ struct shader_spirv_compute_program_vk
     VkDescriptorSetLayout vk_set_layout;
 
     struct vkd3d_shader_scan_descriptor_info descriptor_info;
+    struct shader_spirv_compile_job *job;
 };
 
 struct wined3d_shader_spirv_compile_args
@@ -209,6 +224,435 @@ static const char *get_line(const char **ptr)
     return p;
 }
 
+/* On-disk cache of the SPIR-V translations, shared by the processes using the
+ * prefix. The cache file is a header followed by records, and new records are
+ * appended under an exclusive file lock. The file is mapped when it is opened;
+ * translations added later by the current process are kept in memory. Since a
+ * mapped file can't be truncated, a cache file that is full, corrupted or from
+ * another version is only reset while no other process uses it. */
+
+#define SHADER_SPIRV_CACHE_MAGIC        0x43565053u /* "SPVC" */
+#define SHADER_SPIRV_CACHE_VERSION      1
+#define SHADER_SPIRV_CACHE_MAX_SIZE     (256u * 1024 * 1024)
+/* A cache file larger than this is considered full. */
+#define SHADER_SPIRV_CACHE_FULL_SIZE    (SHADER_SPIRV_CACHE_MAX_SIZE / 16 * 15)
+#define SHADER_SPIRV_CACHE_HASH_INIT    0xcbf29ce484222325ull
+
+struct shader_spirv_cache_key
+{
+    uint8_t checksum[16];
+    uint64_t byte_code_hash;
+    uint64_t args_hash;
+    uint32_t byte_code_size;
+    uint32_t shader_type;
+};
+
+struct shader_spirv_cache_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t vkd3d_version;
+};
+
+struct shader_spirv_cache_record
+{
+    uint32_t magic;
+    uint32_t code_size;
+    uint64_t hash;
+    struct shader_spirv_cache_key key;
+    /* Followed by the SPIR-V code, padded to 8 bytes. */
+};
+
+struct shader_spirv_cache_entry
+{
+    struct wine_rb_entry entry;
+    struct shader_spirv_cache_key key;
+    const void *code;
+    size_t code_size;
+    uint64_t hash;
+    bool verified;
+    /* The record added by this process, or NULL if mapped from the file. */
+    struct shader_spirv_cache_record *record;
+};
+
+static struct
+{
+    bool initialised;
+    bool writable;
+    HANDLE file;
+    const BYTE *view;
+    struct wine_rb_tree entries;
+} shader_spirv_cache;
+
+static CRITICAL_SECTION shader_spirv_cache_cs;
+static CRITICAL_SECTION_DEBUG shader_spirv_cache_cs_debug =
+{
+    0, 0, &shader_spirv_cache_cs,
+    {&shader_spirv_cache_cs_debug.ProcessLocksList,
+    &shader_spirv_cache_cs_debug.ProcessLocksList},
+    0, 0, {(DWORD_PTR)(__FILE__ ": shader_spirv_cache_cs")}
+};
+static CRITICAL_SECTION shader_spirv_cache_cs = {&shader_spirv_cache_cs_debug, -1, 0, 0, 0, 0};
+
+static uint64_t shader_spirv_cache_hash(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *p = data;
+
+    while (size--)
+        hash = (hash ^ *p++) * 0x100000001b3ull;
+
+    return hash;
+}
+
+/* The translations depend on the vkd3d-shader version as well. */
+static uint64_t shader_spirv_cache_get_vkd3d_version(void)
+{
+    const char *version = vkd3d_shader_get_version(NULL, NULL);
+
+    return shader_spirv_cache_hash(SHADER_SPIRV_CACHE_HASH_INIT, version, strlen(version));
+}
+
+static size_t shader_spirv_cache_record_size(size_t code_size)
+{
+    return (sizeof(struct shader_spirv_cache_record) + code_size + 7) & ~(size_t)7;
+}
+
+static uint64_t shader_spirv_cache_record_hash(const struct shader_spirv_cache_key *key,
+        const void *code, size_t code_size)
+{
+    return shader_spirv_cache_hash(shader_spirv_cache_hash(SHADER_SPIRV_CACHE_HASH_INIT,
+            key, sizeof(*key)), code, code_size);
+}
+
+static int shader_spirv_cache_entry_compare(const void *key, const struct wine_rb_entry *entry)
+{
+    const struct shader_spirv_cache_entry *e = WINE_RB_ENTRY_VALUE(entry, struct shader_spirv_cache_entry, entry);
+
+    return memcmp(key, &e->key, sizeof(e->key));
+}
+
+static void shader_spirv_cache_entry_destroy(struct wine_rb_entry *entry, void *context)
+{
+    struct shader_spirv_cache_entry *e = WINE_RB_ENTRY_VALUE(entry, struct shader_spirv_cache_entry, entry);
+
+    heap_free(e->record);
+    heap_free(e);
+}
+
+static void shader_spirv_cache_init_key(struct shader_spirv_cache_key *key,
+        const struct wined3d_shader_desc *shader_desc, enum wined3d_shader_type shader_type,
+        const struct shader_spirv_compile_arguments *args, const struct shader_spirv_resource_bindings *bindings,
+        const struct wined3d_stream_output_desc *so_desc)
+{
+    const struct wined3d_stream_output_element *e;
+    uint64_t hash;
+    unsigned int i;
+
+    memset(key, 0, sizeof(*key));
+    if (shader_desc->byte_code_size >= 20 && !memcmp(shader_desc->byte_code, "DXBC", 4))
+        memcpy(key->checksum, &shader_desc->byte_code[1], sizeof(key->checksum));
+    key->byte_code_hash = shader_spirv_cache_hash(SHADER_SPIRV_CACHE_HASH_INIT,
+            shader_desc->byte_code, shader_desc->byte_code_size);
+    key->byte_code_size = shader_desc->byte_code_size;
+    key->shader_type = shader_type;
+
+    hash = shader_spirv_cache_get_vkd3d_version();
+    if (args)
+        hash = shader_spirv_cache_hash(hash, args, sizeof(*args));
+    hash = shader_spirv_cache_hash(hash, bindings->bindings, bindings->binding_count * sizeof(*bindings->bindings));
+    hash = shader_spirv_cache_hash(hash, bindings->uav_counters,
+            bindings->uav_counter_count * sizeof(*bindings->uav_counters));
+    if (so_desc)
+    {
+        for (i = 0; i < so_desc->element_count; ++i)
+        {
+            e = &so_desc->elements[i];
+            hash = shader_spirv_cache_hash(hash, &e->stream_idx, sizeof(e->stream_idx));
+            if (e->semantic_name)
+                hash = shader_spirv_cache_hash(hash, e->semantic_name, strlen(e->semantic_name) + 1);
+            hash = shader_spirv_cache_hash(hash, &e->semantic_idx, sizeof(e->semantic_idx));
+            hash = shader_spirv_cache_hash(hash, &e->component_idx, sizeof(e->component_idx));
+            hash = shader_spirv_cache_hash(hash, &e->component_count, sizeof(e->component_count));
+            hash = shader_spirv_cache_hash(hash, &e->output_slot, sizeof(e->output_slot));
+        }
+        hash = shader_spirv_cache_hash(hash, so_desc->buffer_strides,
+                so_desc->buffer_stride_count * sizeof(*so_desc->buffer_strides));
+    }
+    key->args_hash = hash;
+}
+
+static bool shader_spirv_cache_add_entry(const struct shader_spirv_cache_key *key,
+        struct shader_spirv_cache_record *record, const void *code, size_t code_size, uint64_t hash, bool verified)
+{
+    struct shader_spirv_cache_entry *entry;
+    struct wine_rb_entry *e;
+
+    /* Later records replace earlier ones with the same key. This only happens
+     * while mapping the file, before any code has been handed out. */
+    if ((e = wine_rb_get(&shader_spirv_cache.entries, key)))
+    {
+        entry = WINE_RB_ENTRY_VALUE(e, struct shader_spirv_cache_entry, entry);
+        heap_free(entry->record);
+    }
+    else
+    {
+        if (!(entry = heap_alloc(sizeof(*entry))))
+            return false;
+        entry->key = *key;
+        wine_rb_put(&shader_spirv_cache.entries, key, &entry->entry);
+    }
+    entry->code = code;
+    entry->code_size = code_size;
+    entry->hash = hash;
+    entry->verified = verified;
+    entry->record = record;
+
+    return true;
+}
+
+/* Map the cache file and index its records. Returns the size of the valid
+ * part of the file, or 0 if the file can't be used at all. The record
+ * contents are only verified when they are first used. */
+static size_t shader_spirv_cache_map(size_t size)
+{
+    const struct shader_spirv_cache_record *record;
+    const struct shader_spirv_cache_header *header;
+    size_t offset, record_size;
+    HANDLE mapping;
+
+    if (size < sizeof(*header))
+        return 0;
+    if (!(mapping = CreateFileMappingW(shader_spirv_cache.file, NULL, PAGE_READONLY, 0, 0, NULL)))
+        return 0;
+    shader_spirv_cache.view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size);
+    CloseHandle(mapping);
+    if (!shader_spirv_cache.view)
+        return 0;
+
+    header = (const struct shader_spirv_cache_header *)shader_spirv_cache.view;
+    if (header->magic != SHADER_SPIRV_CACHE_MAGIC || header->version != SHADER_SPIRV_CACHE_VERSION
+            || header->vkd3d_version != shader_spirv_cache_get_vkd3d_version())
+        return 0;
+
+    for (offset = sizeof(*header); size - offset >= sizeof(*record); offset += record_size)
+    {
+        record = (const struct shader_spirv_cache_record *)(shader_spirv_cache.view + offset);
+        if (record->magic != SHADER_SPIRV_CACHE_MAGIC || record->code_size > size - offset - sizeof(*record))
+            break;
+        if ((record_size = shader_spirv_cache_record_size(record->code_size)) > size - offset)
+            break;
+        if (!shader_spirv_cache_add_entry(&record->key, NULL, record + 1, record->code_size, record->hash, false))
+            break;
+    }
+
+    return offset;
+}
+
+static void shader_spirv_cache_unmap(void)
+{
+    wine_rb_destroy(&shader_spirv_cache.entries, shader_spirv_cache_entry_destroy, NULL);
+    if (shader_spirv_cache.view)
+        UnmapViewOfFile(shader_spirv_cache.view);
+    shader_spirv_cache.view = NULL;
+}
+
+static bool shader_spirv_cache_truncate(size_t size)
+{
+    LARGE_INTEGER offset;
+
+    offset.QuadPart = size;
+    return SetFilePointerEx(shader_spirv_cache.file, offset, NULL, FILE_BEGIN)
+            && SetEndOfFile(shader_spirv_cache.file);
+}
+
+static bool shader_spirv_cache_reset(void)
+{
+    struct shader_spirv_cache_header header;
+    DWORD written;
+
+    if (!shader_spirv_cache_truncate(0))
+        return false;
+
+    header.magic = SHADER_SPIRV_CACHE_MAGIC;
+    header.version = SHADER_SPIRV_CACHE_VERSION;
+    header.vkd3d_version = shader_spirv_cache_get_vkd3d_version();
+    return WriteFile(shader_spirv_cache.file, &header, sizeof(header), &written, NULL) && written == sizeof(header);
+}
+
+static void shader_spirv_cache_init(void)
+{
+    static const WCHAR cache_name[] = L"\\wined3d_spirv.cache";
+    size_t valid_size = 0;
+    WCHAR path[MAX_PATH];
+    LARGE_INTEGER size;
+    OVERLAPPED ov;
+    DWORD len;
+
+    shader_spirv_cache.initialised = true;
+    shader_spirv_cache.file = INVALID_HANDLE_VALUE;
+    wine_rb_init(&shader_spirv_cache.entries, shader_spirv_cache_entry_compare);
+
+    if (!wined3d_settings.shader_cache)
+        return;
+
+    len = GetEnvironmentVariableW(L"LOCALAPPDATA", path, ARRAY_SIZE(path));
+    if (!len || len >= ARRAY_SIZE(path) - ARRAY_SIZE(cache_name))
+        return;
+    wcscat(path, cache_name);
+
+    if ((shader_spirv_cache.file = CreateFileW(path, GENERIC_READ | GENERIC_WRITE,
+            FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, 0, NULL)) == INVALID_HANDLE_VALUE)
+    {
+        WARN("Failed to open shader cache %s, error %u.\n", debugstr_w(path), GetLastError());
+        return;
+    }
+
+    memset(&ov, 0, sizeof(ov));
+    if (!LockFileEx(shader_spirv_cache.file, LOCKFILE_EXCLUSIVE_LOCK, 0, ~0u, ~0u, &ov))
+    {
+        CloseHandle(shader_spirv_cache.file);
+        shader_spirv_cache.file = INVALID_HANDLE_VALUE;
+        return;
+    }
+
+    if (!GetFileSizeEx(shader_spirv_cache.file, &size))
+        size.QuadPart = 0;
+    /* Start over with a full cache, so that new translations can be stored. */
+    if (size.QuadPart > SHADER_SPIRV_CACHE_FULL_SIZE && shader_spirv_cache_reset())
+    {
+        TRACE("Shader cache %s is full, reset it.\n", debugstr_w(path));
+        size.QuadPart = sizeof(struct shader_spirv_cache_header);
+    }
+    if (size.QuadPart <= SHADER_SPIRV_CACHE_MAX_SIZE)
+    {
+        if ((valid_size = shader_spirv_cache_map(size.QuadPart)) == size.QuadPart)
+        {
+            shader_spirv_cache.writable = true;
+        }
+        else
+        {
+            /* Drop the corrupted tail, unless the file is still in use. */
+            shader_spirv_cache_unmap();
+            if (valid_size)
+            {
+                WARN("Shader cache %s is corrupted at offset %#Ix.\n", debugstr_w(path), valid_size);
+                shader_spirv_cache.writable = shader_spirv_cache_truncate(valid_size);
+                shader_spirv_cache_map(valid_size);
+            }
+        }
+    }
+    if (!valid_size)
+        shader_spirv_cache.writable = shader_spirv_cache_reset();
+
+    TRACE("Loaded shader cache %s, size %#Ix, writable %#x.\n",
+            debugstr_w(path), valid_size, shader_spirv_cache.writable);
+
+    UnlockFileEx(shader_spirv_cache.file, 0, ~0u, ~0u, &ov);
+    if (!shader_spirv_cache.writable)
+    {
+        shader_spirv_cache_unmap();
+        CloseHandle(shader_spirv_cache.file);
+        shader_spirv_cache.file = INVALID_HANDLE_VALUE;
+    }
+}
+
+void wined3d_spirv_shader_cache_cleanup(void)
+{
+    if (!shader_spirv_cache.initialised)
+        return;
+
+    shader_spirv_cache_unmap();
+    if (shader_spirv_cache.file != INVALID_HANDLE_VALUE)
+        CloseHandle(shader_spirv_cache.file);
+    shader_spirv_cache.file = INVALID_HANDLE_VALUE;
+    shader_spirv_cache.writable = false;
+    shader_spirv_cache.initialised = false;
+}
+
+static bool shader_spirv_cache_get(const struct shader_spirv_cache_key *key, struct vkd3d_shader_code *code)
+{
+    struct shader_spirv_cache_entry *entry = NULL;
+    struct wine_rb_entry *e;
+
+    if (!wined3d_settings.shader_cache)
+        return false;
+
+    EnterCriticalSection(&shader_spirv_cache_cs);
+
+    if (!shader_spirv_cache.initialised)
+        shader_spirv_cache_init();
+
+    if (shader_spirv_cache.writable && (e = wine_rb_get(&shader_spirv_cache.entries, key)))
+    {
+        entry = WINE_RB_ENTRY_VALUE(e, struct shader_spirv_cache_entry, entry);
+        if (!entry->verified && entry->hash != shader_spirv_cache_record_hash(key, entry->code, entry->code_size))
+        {
+            WARN("Ignoring corrupted shader cache entry.\n");
+            wine_rb_remove(&shader_spirv_cache.entries, e);
+            shader_spirv_cache_entry_destroy(e, NULL);
+            entry = NULL;
+        }
+        else
+        {
+            entry->verified = true;
+            code->code = entry->code;
+            code->size = entry->code_size;
+        }
+    }
+
+    LeaveCriticalSection(&shader_spirv_cache_cs);
+
+    return !!entry;
+}
+
+static void shader_spirv_cache_put(const struct shader_spirv_cache_key *key, const struct vkd3d_shader_code *code)
+{
+    struct shader_spirv_cache_record *record;
+    LARGE_INTEGER offset, end;
+    size_t record_size;
+    DWORD written;
+    OVERLAPPED ov;
+
+    /* shader_spirv_cache_get() has always been called first, so the cache is
+     * initialised here. */
+    if (!wined3d_settings.shader_cache || !shader_spirv_cache.writable)
+        return;
+
+    record_size = shader_spirv_cache_record_size(code->size);
+    if (!(record = heap_alloc_zero(record_size)))
+        return;
+    record->magic = SHADER_SPIRV_CACHE_MAGIC;
+    record->code_size = code->size;
+    record->key = *key;
+    record->hash = shader_spirv_cache_record_hash(key, code->code, code->size);
+    memcpy(record + 1, code->code, code->size);
+
+    EnterCriticalSection(&shader_spirv_cache_cs);
+
+    /* Another thread may have added the same translation meanwhile. Its code
+     * may already be in use, so keep it. */
+    if (wine_rb_get(&shader_spirv_cache.entries, key)
+            || !shader_spirv_cache_add_entry(key, record, record + 1, code->size, record->hash, true))
+    {
+        LeaveCriticalSection(&shader_spirv_cache_cs);
+        heap_free(record);
+        return;
+    }
+
+    memset(&ov, 0, sizeof(ov));
+    if (LockFileEx(shader_spirv_cache.file, LOCKFILE_EXCLUSIVE_LOCK, 0, ~0u, ~0u, &ov))
+    {
+        offset.QuadPart = 0;
+        if (SetFilePointerEx(shader_spirv_cache.file, offset, &end, FILE_END)
+                && end.QuadPart + record_size <= SHADER_SPIRV_CACHE_MAX_SIZE
+                && !WriteFile(shader_spirv_cache.file, record, record_size, &written, NULL))
+            WARN("Failed to write shader cache record, error %u.\n", GetLastError());
+        UnlockFileEx(shader_spirv_cache.file, 0, ~0u, ~0u, &ov);
+    }
+
+    LeaveCriticalSection(&shader_spirv_cache_cs);
+}
+
 static void shader_spirv_init_shader_interface_vk(struct wined3d_shader_spirv_shader_interface *iface,
         const struct shader_spirv_resource_bindings *b, const struct wined3d_stream_output_desc *so_desc)
 {
@@ -235,23 +679,22 @@ static void shader_spirv_init_shader_interface_vk(struct wined3d_shader_spirv_sh
     iface->vkd3d_interface.uav_counter_count = b->uav_counter_count;
 }
 
-static VkShaderModule shader_spirv_compile_shader(struct wined3d_context_vk *context_vk,
-        const struct wined3d_shader_desc *shader_desc, enum wined3d_shader_type shader_type,
-        const struct shader_spirv_compile_arguments *args, const struct shader_spirv_resource_bindings *bindings,
-        const struct wined3d_stream_output_desc *so_desc)
+static int shader_spirv_translate_shader(const struct wined3d_shader_desc *shader_desc,
+        enum wined3d_shader_type shader_type, const struct shader_spirv_compile_arguments *args,
+        const struct shader_spirv_resource_bindings *bindings, const struct wined3d_stream_output_desc *so_desc,
+        struct vkd3d_shader_code *spirv, bool *cached)
 {
     struct wined3d_shader_spirv_compile_args compile_args;
     struct wined3d_shader_spirv_shader_interface iface;
-    VkShaderModuleCreateInfo shader_create_info;
+    struct shader_spirv_cache_key cache_key;
     struct vkd3d_shader_compile_info info;
-    const struct wined3d_vk_info *vk_info;
-    struct wined3d_device_vk *device_vk;
-    struct vkd3d_shader_code spirv;
-    VkShaderModule module;
     char *messages;
-    VkResult vr;
     int ret;
 
+    shader_spirv_cache_init_key(&cache_key, shader_desc, shader_type, args, bindings, so_desc);
+    if ((*cached = shader_spirv_cache_get(&cache_key, spirv)))
+        return VKD3D_OK;
+
     shader_spirv_init_shader_interface_vk(&iface, bindings, so_desc);
     shader_spirv_init_compile_args(&compile_args, &iface.vkd3d_interface,
             VKD3D_SHADER_SPIRV_ENVIRONMENT_VULKAN_1_0, shader_type, args);
@@ -267,7 +710,7 @@ static VkShaderModule shader_spirv_compile_shader(struct wined3d_context_vk *con
     info.log_level = VKD3D_SHADER_LOG_WARNING;
     info.source_name = NULL;
 
-    ret = vkd3d_shader_compile(&info, &spirv, &messages);
+    ret = vkd3d_shader_compile(&info, spirv, &messages);
     if (messages && *messages && FIXME_ON(d3d_shader))
     {
         const char *ptr = messages;
@@ -285,25 +728,52 @@ static VkShaderModule shader_spirv_compile_shader(struct wined3d_context_vk *con
     if (ret < 0)
     {
         ERR("Failed to compile DXBC, ret %d.\n", ret);
-        return VK_NULL_HANDLE;
+        return ret;
     }
 
-    device_vk = wined3d_device_vk(context_vk->c.device);
-    vk_info = &device_vk->vk_info;
+    shader_spirv_cache_put(&cache_key, spirv);
+
+    return ret;
+}
+
+static VkShaderModule shader_spirv_create_module(struct wined3d_context_vk *context_vk,
+        const struct vkd3d_shader_code *spirv)
+{
+    struct wined3d_device_vk *device_vk = wined3d_device_vk(context_vk->c.device);
+    const struct wined3d_vk_info *vk_info = &device_vk->vk_info;
+    VkShaderModuleCreateInfo shader_create_info;
+    VkShaderModule module;
+    VkResult vr;
 
     shader_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     shader_create_info.pNext = NULL;
     shader_create_info.flags = 0;
-    shader_create_info.codeSize = spirv.size;
-    shader_create_info.pCode = spirv.code;
+    shader_create_info.codeSize = spirv->size;
+    shader_create_info.pCode = spirv->code;
     if ((vr = VK_CALL(vkCreateShaderModule(device_vk->vk_device, &shader_create_info, NULL, &module))) < 0)
     {
-        vkd3d_shader_free_shader_code(&spirv);
         WARN("Failed to create Vulkan shader module, vr %s.\n", wined3d_debug_vkresult(vr));
         return VK_NULL_HANDLE;
     }
 
-    vkd3d_shader_free_shader_code(&spirv);
+    return module;
+}
+
+static VkShaderModule shader_spirv_compile_shader(struct wined3d_context_vk *context_vk,
+        const struct wined3d_shader_desc *shader_desc, enum wined3d_shader_type shader_type,
+        const struct shader_spirv_compile_arguments *args, const struct shader_spirv_resource_bindings *bindings,
+        const struct wined3d_stream_output_desc *so_desc)
+{
+    struct vkd3d_shader_code spirv;
+    VkShaderModule module;
+    bool cached;
+
+    if (shader_spirv_translate_shader(shader_desc, shader_type, args, bindings, so_desc, &spirv, &cached) < 0)
+        return VK_NULL_HANDLE;
+
+    module = shader_spirv_create_module(context_vk, &spirv);
+    if (!cached)
+        vkd3d_shader_free_shader_code(&spirv);
 
     return module;
 }
@@ -356,6 +826,30 @@ static struct shader_spirv_graphics_program_variant_vk *shader_spirv_find_graphi
     return variant_vk;
 }
 
+static void shader_spirv_resource_bindings_cleanup(struct shader_spirv_resource_bindings *bindings)
+{
+    heap_free(bindings->vk_bindings);
+    heap_free(bindings->bindings);
+}
+
+static void shader_spirv_compile_job_destroy(struct shader_spirv_compile_job *job)
+{
+    WaitForThreadpoolWorkCallbacks(job->work, FALSE);
+    CloseThreadpoolWork(job->work);
+    if (job->ret >= 0 && !job->cached)
+        vkd3d_shader_free_shader_code(&job->spirv);
+    shader_spirv_resource_bindings_cleanup(&job->bindings);
+    heap_free(job);
+}
+
+static bool shader_spirv_resource_bindings_equal(const struct shader_spirv_resource_bindings *a,
+        const struct shader_spirv_resource_bindings *b)
+{
+    return a->binding_count == b->binding_count && a->uav_counter_count == b->uav_counter_count
+            && !memcmp(a->bindings, b->bindings, a->binding_count * sizeof(*a->bindings))
+            && !memcmp(a->uav_counters, b->uav_counters, a->uav_counter_count * sizeof(*a->uav_counters));
+}
+
 static struct shader_spirv_compute_program_vk *shader_spirv_find_compute_program_vk(struct shader_spirv_priv *priv,
         struct wined3d_context_vk *context_vk, struct wined3d_shader *shader,
         const struct shader_spirv_resource_bindings *bindings)
@@ -365,6 +859,7 @@ static struct shader_spirv_compute_program_vk *shader_spirv_find_compute_program
     struct shader_spirv_compute_program_vk *program;
     struct wined3d_pipeline_layout_vk *layout;
     VkComputePipelineCreateInfo pipeline_info;
+    struct shader_spirv_compile_job *job;
     struct wined3d_shader_desc shader_desc;
     VkResult vr;
 
@@ -374,11 +869,23 @@ static struct shader_spirv_compute_program_vk *shader_spirv_find_compute_program
     if (program->vk_module)
         return program;
 
+    if ((job = program->job))
+    {
+        /* The background translation used the bindings of the compute
+         * shader on its own, which is all the compute pipeline layout
+         * depends on; check anyway, rather than trusting that. */
+        WaitForThreadpoolWorkCallbacks(job->work, FALSE);
+        if (job->ret >= 0 && shader_spirv_resource_bindings_equal(&job->bindings, bindings))
+            program->vk_module = shader_spirv_create_module(context_vk, &job->spirv);
+        shader_spirv_compile_job_destroy(job);
+        program->job = NULL;
+    }
+
     shader_desc.byte_code = shader->byte_code;
     shader_desc.byte_code_size = shader->byte_code_size;
 
-    if (!(program->vk_module = shader_spirv_compile_shader(context_vk, &shader_desc, WINED3D_SHADER_TYPE_COMPUTE,
-            NULL, bindings, NULL)))
+    if (!program->vk_module && !(program->vk_module = shader_spirv_compile_shader(context_vk,
+            &shader_desc, WINED3D_SHADER_TYPE_COMPUTE, NULL, bindings, NULL)))
         return NULL;
 
     if (!(layout = wined3d_context_vk_get_pipeline_layout(context_vk,
@@ -416,12 +923,6 @@ static struct shader_spirv_compute_program_vk *shader_spirv_find_compute_program
     return program;
 }
 
-static void shader_spirv_resource_bindings_cleanup(struct shader_spirv_resource_bindings *bindings)
-{
-    heap_free(bindings->vk_bindings);
-    heap_free(bindings->bindings);
-}
-
 static bool shader_spirv_resource_bindings_add_vk_binding(struct shader_spirv_resource_bindings *bindings,
         VkDescriptorType vk_type, VkShaderStageFlagBits vk_stage, size_t *binding_idx)
 {
@@ -598,20 +1099,73 @@ static enum wined3d_data_type wined3d_data_type_from_vkd3d(enum vkd3d_shader_res
     }
 }
 
-static bool shader_spirv_resource_bindings_init(struct shader_spirv_resource_bindings *bindings,
-        struct wined3d_shader_resource_bindings *wined3d_bindings,
-        const struct wined3d_state *state, uint32_t shader_mask)
+static bool shader_spirv_resource_bindings_add_shader(struct shader_spirv_resource_bindings *bindings,
+        struct wined3d_shader_resource_bindings *wined3d_bindings, enum wined3d_shader_type shader_type,
+        const struct vkd3d_shader_scan_descriptor_info *descriptor_info)
 {
-    struct vkd3d_shader_scan_descriptor_info *descriptor_info;
     enum wined3d_shader_descriptor_type wined3d_type;
     enum vkd3d_shader_visibility shader_visibility;
-    enum wined3d_shader_type shader_type;
     VkDescriptorType vk_descriptor_type;
     VkShaderStageFlagBits vk_stage;
-    struct wined3d_shader *shader;
     size_t binding_idx;
     unsigned int i;
 
+    vk_stage = vk_shader_stage_from_wined3d(shader_type);
+    shader_visibility = vkd3d_shader_visibility_from_wined3d(shader_type);
+
+    for (i = 0; i < descriptor_info->descriptor_count; ++i)
+    {
+        struct vkd3d_shader_descriptor_info *d = &descriptor_info->descriptors[i];
+        uint32_t flags;
+
+        if (d->register_space)
+        {
+            WARN("Unsupported register space %u.\n", d->register_space);
+            return false;
+        }
+
+        if (d->resource_type == VKD3D_SHADER_RESOURCE_BUFFER)
+            flags = VKD3D_SHADER_BINDING_FLAG_BUFFER;
+        else
+            flags = VKD3D_SHADER_BINDING_FLAG_IMAGE;
+
+        vk_descriptor_type = vk_descriptor_type_from_vkd3d(d->type, d->resource_type);
+        if (!shader_spirv_resource_bindings_add_binding(bindings, d->type, vk_descriptor_type,
+                d->register_index, shader_visibility, vk_stage, flags, &binding_idx))
+            return false;
+
+        wined3d_type = wined3d_descriptor_type_from_vkd3d(d->type);
+        if (!wined3d_shader_resource_bindings_add_binding(wined3d_bindings, shader_type,
+                wined3d_type, d->register_index, wined3d_shader_resource_type_from_vkd3d(d->resource_type),
+                wined3d_data_type_from_vkd3d(d->resource_data_type), binding_idx))
+            return false;
+
+        if (d->type == VKD3D_SHADER_DESCRIPTOR_TYPE_UAV
+                && (d->flags & VKD3D_SHADER_DESCRIPTOR_INFO_FLAG_UAV_COUNTER))
+        {
+            if (!shader_spirv_resource_bindings_add_uav_counter_binding(bindings,
+                    d->register_index, shader_visibility, vk_stage, &binding_idx))
+                return false;
+            if (!wined3d_shader_resource_bindings_add_binding(wined3d_bindings,
+                    shader_type, WINED3D_SHADER_DESCRIPTOR_TYPE_UAV_COUNTER, d->register_index,
+                    WINED3D_SHADER_RESOURCE_BUFFER, WINED3D_DATA_UINT, binding_idx))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static bool shader_spirv_resource_bindings_init(struct shader_spirv_resource_bindings *bindings,
+        struct wined3d_shader_resource_bindings *wined3d_bindings,
+        const struct wined3d_state *state, uint32_t shader_mask)
+{
+    struct shader_spirv_compute_program_vk *compute_program;
+    struct shader_spirv_graphics_program_vk *graphics_program;
+    struct vkd3d_shader_scan_descriptor_info *descriptor_info;
+    enum wined3d_shader_type shader_type;
+    struct wined3d_shader *shader;
+
     bindings->binding_count = 0;
     bindings->uav_counter_count = 0;
     bindings->vk_binding_count = 0;
@@ -627,57 +1181,27 @@ static bool shader_spirv_resource_bindings_init(struct shader_spirv_resource_bin
 
         if (shader_type == WINED3D_SHADER_TYPE_COMPUTE)
         {
-            descriptor_info = &((struct shader_spirv_compute_program_vk *)shader->backend_data)->descriptor_info;
+            compute_program = shader->backend_data;
+            /* The job is consumed by shader_spirv_find_compute_program_vk(). */
+            if (compute_program->job)
+                WaitForThreadpoolWorkCallbacks(compute_program->job->work, FALSE);
+            descriptor_info = &compute_program->descriptor_info;
         }
         else
         {
-            descriptor_info = &((struct shader_spirv_graphics_program_vk *)shader->backend_data)->descriptor_info;
+            graphics_program = shader->backend_data;
+            if (graphics_program->job)
+            {
+                shader_spirv_compile_job_destroy(graphics_program->job);
+                graphics_program->job = NULL;
+            }
+            descriptor_info = &graphics_program->descriptor_info;
             if (shader_type == WINED3D_SHADER_TYPE_GEOMETRY && !shader->function)
                 bindings->so_stage = WINED3D_SHADER_TYPE_VERTEX;
         }
 
-        vk_stage = vk_shader_stage_from_wined3d(shader_type);
-        shader_visibility = vkd3d_shader_visibility_from_wined3d(shader_type);
-
-        for (i = 0; i < descriptor_info->descriptor_count; ++i)
-        {
-            struct vkd3d_shader_descriptor_info *d = &descriptor_info->descriptors[i];
-            uint32_t flags;
-
-            if (d->register_space)
-            {
-                WARN("Unsupported register space %u.\n", d->register_space);
-                return false;
-            }
-
-            if (d->resource_type == VKD3D_SHADER_RESOURCE_BUFFER)
-                flags = VKD3D_SHADER_BINDING_FLAG_BUFFER;
-            else
-                flags = VKD3D_SHADER_BINDING_FLAG_IMAGE;
-
-            vk_descriptor_type = vk_descriptor_type_from_vkd3d(d->type, d->resource_type);
-            if (!shader_spirv_resource_bindings_add_binding(bindings, d->type, vk_descriptor_type,
-                    d->register_index, shader_visibility, vk_stage, flags, &binding_idx))
-                return false;
-
-            wined3d_type = wined3d_descriptor_type_from_vkd3d(d->type);
-            if (!wined3d_shader_resource_bindings_add_binding(wined3d_bindings, shader_type,
-                    wined3d_type, d->register_index, wined3d_shader_resource_type_from_vkd3d(d->resource_type),
-                    wined3d_data_type_from_vkd3d(d->resource_data_type), binding_idx))
-                return false;
-
-            if (d->type == VKD3D_SHADER_DESCRIPTOR_TYPE_UAV
-                    && (d->flags & VKD3D_SHADER_DESCRIPTOR_INFO_FLAG_UAV_COUNTER))
-            {
-                if (!shader_spirv_resource_bindings_add_uav_counter_binding(bindings,
-                        d->register_index, shader_visibility, vk_stage, &binding_idx))
-                    return false;
-                if (!wined3d_shader_resource_bindings_add_binding(wined3d_bindings,
-                        shader_type, WINED3D_SHADER_DESCRIPTOR_TYPE_UAV_COUNTER, d->register_index,
-                        WINED3D_SHADER_RESOURCE_BUFFER, WINED3D_DATA_UINT, binding_idx))
-                    return false;
-            }
-        }
+        if (!shader_spirv_resource_bindings_add_shader(bindings, wined3d_bindings, shader_type, descriptor_info))
+            return false;
     }
 
     return true;
@@ -721,6 +1245,55 @@ static void shader_spirv_scan_shader(struct wined3d_shader *shader,
     vkd3d_shader_free_messages(messages);
 }
 
+static void CALLBACK shader_spirv_compile_job_cb(TP_CALLBACK_INSTANCE *instance, void *ctx, TP_WORK *work)
+{
+    struct wined3d_shader_resource_bindings wined3d_bindings = {0};
+    struct shader_spirv_compile_job *job = ctx;
+    struct wined3d_shader *shader = job->shader;
+    struct wined3d_shader_desc shader_desc;
+
+    shader_spirv_scan_shader(shader, job->descriptor_info);
+
+    if (shader->reg_maps.shader_version.type != WINED3D_SHADER_TYPE_COMPUTE)
+        return;
+
+    /* Unlike graphics shaders, whose bindings and compile arguments depend
+     * on the other stages and on the pipeline state, compute shaders can be
+     * translated completely before they are first used. */
+    job->bindings.so_stage = WINED3D_SHADER_TYPE_GEOMETRY;
+    if (shader_spirv_resource_bindings_add_shader(&job->bindings, &wined3d_bindings,
+            WINED3D_SHADER_TYPE_COMPUTE, job->descriptor_info))
+    {
+        shader_desc.byte_code = shader->byte_code;
+        shader_desc.byte_code_size = shader->byte_code_size;
+        job->ret = shader_spirv_translate_shader(&shader_desc, WINED3D_SHADER_TYPE_COMPUTE,
+                NULL, &job->bindings, NULL, &job->spirv, &job->cached);
+    }
+    heap_free(wined3d_bindings.bindings);
+}
+
+static struct shader_spirv_compile_job *shader_spirv_compile_job_create(struct wined3d_shader *shader,
+        struct vkd3d_shader_scan_descriptor_info *descriptor_info)
+{
+    struct shader_spirv_compile_job *job;
+
+    if (!(job = heap_alloc_zero(sizeof(*job))))
+        return NULL;
+    job->shader = shader;
+    job->descriptor_info = descriptor_info;
+    job->ret = VKD3D_ERROR;
+
+    if (!(job->work = CreateThreadpoolWork(shader_spirv_compile_job_cb, job, NULL)))
+    {
+        WARN("Failed to create thread pool work, error %u.\n", GetLastError());
+        heap_free(job);
+        return NULL;
+    }
+    SubmitThreadpoolWork(job->work);
+
+    return job;
+}
+
 static void shader_spirv_precompile_compute(struct wined3d_shader *shader)
 {
     struct shader_spirv_compute_program_vk *program_vk;
@@ -732,7 +1305,8 @@ static void shader_spirv_precompile_compute(struct wined3d_shader *shader)
         shader->backend_data = program_vk;
     }
 
-    shader_spirv_scan_shader(shader, &program_vk->descriptor_info);
+    if (!(program_vk->job = shader_spirv_compile_job_create(shader, &program_vk->descriptor_info)))
+        shader_spirv_scan_shader(shader, &program_vk->descriptor_info);
 }
 
 static void shader_spirv_precompile(void *shader_priv, struct wined3d_shader *shader)
@@ -754,7 +1328,8 @@ static void shader_spirv_precompile(void *shader_priv, struct wined3d_shader *sh
         shader->backend_data = program_vk;
     }
 
-    shader_spirv_scan_shader(shader, &program_vk->descriptor_info);
+    if (!(program_vk->job = shader_spirv_compile_job_create(shader, &program_vk->descriptor_info)))
+        shader_spirv_scan_shader(shader, &program_vk->descriptor_info);
 }
 
 static void shader_spirv_select(void *shader_priv, struct wined3d_context *context,
@@ -928,6 +1503,8 @@ static void shader_spirv_destroy_compute_vk(struct wined3d_shader *shader)
     struct shader_spirv_compute_program_vk *program = shader->backend_data;
     struct wined3d_vk_info *vk_info = &device_vk->vk_info;
 
+    if (program->job)
+        shader_spirv_compile_job_destroy(program->job);
     shader_spirv_invalidate_contexts_compute_program(&device_vk->d, program);
     VK_CALL(vkDestroyPipeline(device_vk->vk_device, program->vk_pipeline, NULL));
     VK_CALL(vkDestroyShaderModule(device_vk->vk_device, program->vk_module, NULL));
@@ -961,6 +1538,8 @@ static void shader_spirv_destroy(struct wined3d_shader *shader)
         VK_CALL(vkDestroyShaderModule(device_vk->vk_device, variant_vk->vk_module, NULL));
     }
     heap_free(program_vk->variants);
+    if (program_vk->job)
+        shader_spirv_compile_job_destroy(program_vk->job);
     vkd3d_shader_free_scan_descriptor_info(&program_vk->descriptor_info);
 
     shader->backend_data = NULL;
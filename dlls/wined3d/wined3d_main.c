@@ -122,6 +122,7 @@ struct wined3d_settings wined3d_settings =
     .max_sm_cs = UINT_MAX,
     .renderer = WINED3D_RENDERER_AUTO,
     .shader_backend = WINED3D_SHADER_BACKEND_AUTO,
+    .shader_cache = TRUE,
 };
 
 struct wined3d * CDECL wined3d_create(DWORD flags)
@@ -456,6 +457,8 @@ static BOOL wined3d_dll_init(HINSTANCE hInstDLL)
             TRACE("Forcing all constant buffers to be write-mappable.\n");
             wined3d_settings.cb_access_map_w = TRUE;
         }
+        if (!get_config_key_dword(hkey, appkey, env, "shader_cache", &wined3d_settings.shader_cache))
+            TRACE("Setting shader cache to %#x.\n", wined3d_settings.shader_cache);
     }
 
     if (appkey) RegCloseKey( appkey );
@@ -496,6 +499,7 @@ static BOOL wined3d_dll_destroy(HINSTANCE hInstDLL)
     heap_free(swapchain_state_table.hooks);
 
     heap_free(wined3d_settings.logo);
+    wined3d_spirv_shader_cache_cleanup();
     UnregisterClassA(WINED3D_OPENGL_WINDOW_CLASS_NAME, hInstDLL);
 
     DeleteCriticalSection(&wined3d_command_cs);
@@ -11822,6 +11822,60 @@ static void test_simultaneous_async_recv(void)
     for (i = 0; i < num_io; i++) CloseHandle(events[i]);
 }
 
+static void test_mixed_async_sync_recv(void)
+{
+    OVERLAPPED overlapped = {0};
+    SOCKET client, server;
+    char buffer[16], async_buffer[4];
+    DWORD size, flags = 0;
+    WSABUF wsabuf;
+    int ret;
+
+    overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    tcp_socketpair(&client, &server);
+
+    ret = send(server, "abcd", 4, 0);
+    ok(ret == 4, "got %d\n", ret);
+    ret = recv(client, buffer, sizeof(buffer), 0);
+    ok(ret == 4, "got %d\n", ret);
+    ok(!memcmp(buffer, "abcd", 4), "got %s\n", debugstr_an(buffer, ret));
+
+    wsabuf.buf = async_buffer;
+    wsabuf.len = sizeof(async_buffer);
+    ret = WSARecv(client, &wsabuf, 1, NULL, &flags, &overlapped, NULL);
+    ok(ret == -1, "got %d\n", ret);
+    ok(WSAGetLastError() == ERROR_IO_PENDING, "got error %u\n", WSAGetLastError());
+
+    ret = send(server, "efghijkl", 8, 0);
+    ok(ret == 8, "got %d\n", ret);
+
+    /* the pending overlapped recv gets the data first */
+    ret = recv(client, buffer, sizeof(buffer), 0);
+    ok(ret == 4, "got %d\n", ret);
+    ok(!memcmp(buffer, "ijkl", 4), "got %s\n", debugstr_an(buffer, ret));
+
+    ret = WaitForSingleObject(overlapped.hEvent, 1000);
+    ok(!ret, "wait failed\n");
+    ret = GetOverlappedResult((HANDLE)client, &overlapped, &size, FALSE);
+    ok(ret, "got error %lu\n", GetLastError());
+    ok(size == 4, "got size %lu\n", size);
+    ok(!memcmp(async_buffer, "efgh", 4), "got %s\n", debugstr_an(async_buffer, size));
+
+    /* data received before the shutdown can't be read anymore */
+    ret = send(server, "mnop", 4, 0);
+    ok(ret == 4, "got %d\n", ret);
+    ret = shutdown(client, SD_RECEIVE);
+    ok(!ret, "got error %u\n", WSAGetLastError());
+    WSASetLastError(0xdeadbeef);
+    ret = recv(client, buffer, sizeof(buffer), 0);
+    ok(ret == -1, "got %d\n", ret);
+    ok(WSAGetLastError() == WSAESHUTDOWN, "got error %u\n", WSAGetLastError());
+
+    closesocket(client);
+    closesocket(server);
+    CloseHandle(overlapped.hEvent);
+}
+
 static void test_empty_recv(void)
 {
     OVERLAPPED overlapped = {0};
@@ -12381,6 +12435,7 @@ START_TEST( sock )
     test_WSAGetOverlappedResult();
     test_nonblocking_async_recv();
     test_simultaneous_async_recv();
+    test_mixed_async_sync_recv();
     test_empty_recv();
     test_timeout();
 
@@ -176,6 +176,17 @@ struct send_fd
 };
 
 
+
+#define SOCK_STATE_SLOTS        65536
+#define SOCK_STATE_SERIAL_SHIFT 2
+#define SOCK_STATE_DIRECT_RECV  0x01
+#define SOCK_STATE_DIRECT_SEND  0x02
+
+
+
+#define SERVER_PUSHED_FD_FLAG 0x01
+
+
 struct wake_up_reply
 {
     client_ptr_t cookie;
@@ -1583,7 +1594,9 @@ struct create_file_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    int          type;
+    unsigned int access;
+    unsigned int options;
 };
 
 
@@ -1765,10 +1778,11 @@ struct unlock_file_reply
 struct recv_socket_request
 {
     struct request_header __header;
-    int          oob;
+    unsigned short oob;
+    unsigned short force_async;
     async_data_t async;
-    int          force_async;
-    char __pad_60[4];
+    unsigned int status;
+    data_size_t  total;
 };
 struct recv_socket_reply
 {
@@ -1776,7 +1790,7 @@ struct recv_socket_reply
     obj_handle_t wait;
     unsigned int options;
     int          nonblocking;
-    char __pad_20[4];
+    unsigned int state_serial;
 };
 
 
@@ -1784,10 +1798,10 @@ struct recv_socket_reply
 struct send_socket_request
 {
     struct request_header __header;
-    char __pad_12[4];
+    unsigned int status;
     async_data_t async;
     int          force_async;
-    char __pad_60[4];
+    data_size_t  total;
 };
 struct send_socket_reply
 {
@@ -1795,7 +1809,7 @@ struct send_socket_reply
     obj_handle_t wait;
     unsigned int options;
     int          nonblocking;
-    char __pad_20[4];
+    unsigned int state_serial;
 };
 
 
@@ -4584,6 +4598,26 @@ struct get_system_handles_reply
 
 
 
+struct get_handle_table_stats_request
+{
+    struct request_header __header;
+    obj_handle_t    handle;
+};
+struct get_handle_table_stats_reply
+{
+    struct reply_header __header;
+    unsigned int    count;
+    unsigned int    used;
+    unsigned int    peak;
+    unsigned int    free_count;
+    unsigned int    allocs;
+    unsigned int    frees;
+    unsigned int    compactions;
+    char __pad_36[4];
+};
+
+
+
 struct create_mailslot_request
 {
     struct request_header __header;
@@ -5051,6 +5085,28 @@ struct remove_completion_reply
 };
 
 
+struct completion_info
+{
+    apc_param_t   ckey;
+    apc_param_t   cvalue;
+    apc_param_t   information;
+    unsigned int  status;
+    unsigned int  __pad;
+};
+
+
+struct remove_completions_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct remove_completions_reply
+{
+    struct reply_header __header;
+    /* VARARG(infos,completion_infos); */
+};
+
+
 
 struct query_completion_request
 {
@@ -5766,6 +5822,7 @@ enum request
     REQ_set_security_object,
     REQ_get_security_object,
     REQ_get_system_handles,
+    REQ_get_handle_table_stats,
     REQ_create_mailslot,
     REQ_set_mailslot_info,
     REQ_create_directory,
@@ -5795,6 +5852,7 @@ enum request
     REQ_open_completion,
     REQ_add_completion,
     REQ_remove_completion,
+    REQ_remove_completions,
     REQ_query_completion,
     REQ_set_completion_info,
     REQ_add_fd_completion,
@@ -6054,6 +6112,7 @@ union generic_request
     struct set_security_object_request set_security_object_request;
     struct get_security_object_request get_security_object_request;
     struct get_system_handles_request get_system_handles_request;
+    struct get_handle_table_stats_request get_handle_table_stats_request;
     struct create_mailslot_request create_mailslot_request;
     struct set_mailslot_info_request set_mailslot_info_request;
     struct create_directory_request create_directory_request;
@@ -6083,6 +6142,7 @@ union generic_request
     struct open_completion_request open_completion_request;
     struct add_completion_request add_completion_request;
     struct remove_completion_request remove_completion_request;
+    struct remove_completions_request remove_completions_request;
     struct query_completion_request query_completion_request;
     struct set_completion_info_request set_completion_info_request;
     struct add_fd_completion_request add_fd_completion_request;
@@ -6340,6 +6400,7 @@ union generic_reply
     struct set_security_object_reply set_security_object_reply;
     struct get_security_object_reply get_security_object_reply;
     struct get_system_handles_reply get_system_handles_reply;
+    struct get_handle_table_stats_reply get_handle_table_stats_reply;
     struct create_mailslot_reply create_mailslot_reply;
     struct set_mailslot_info_reply set_mailslot_info_reply;
     struct create_directory_reply create_directory_reply;
@@ -6369,6 +6430,7 @@ union generic_reply
     struct open_completion_reply open_completion_reply;
     struct add_completion_reply add_completion_reply;
     struct remove_completion_reply remove_completion_reply;
+    struct remove_completions_reply remove_completions_reply;
     struct query_completion_reply query_completion_reply;
     struct set_completion_info_reply set_completion_info_reply;
     struct add_fd_completion_reply add_fd_completion_reply;
@@ -6405,7 +6467,7 @@ union generic_reply
 
 /* ### protocol_version begin ### */
 
-#define SERVER_PROTOCOL_VERSION 750
+#define SERVER_PROTOCOL_VERSION 756
 
 /* ### protocol_version end ### */
 
@@ -0,0 +1,440 @@
+/*
+ * vkd3d-shader throughput benchmark
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Compiles every shader found in the given files and directories with
+ * vkd3d-shader, and prints one tab-separated record per compilation stage:
+ *
+ *   compile <file> <source> <stage> <iterations> <min_us> <median_us> <output_size>
+ *
+ * followed by the process memory peaks:
+ *
+ *   memory <peak_working_set> <peak_private_bytes>
+ *
+ * DXBC is identified by its header, legacy d3d bytecode by its version
+ * token, and anything with a .hlsl or .fx extension is HLSL. The HLSL
+ * profile is taken from the file name ("name.ps_4_0.hlsl") or from -p.
+ * HLSL output is fed into the DXBC stages, so "spirv" and "d3d-asm" are
+ * reported for every shader model 4+ source.
+ *
+ * The stages map onto the translator as follows: "preprocess" is preproc.y,
+ * "hlsl" is the HLSL front end plus hlsl_codegen.c and the bytecode writer,
+ * "scan" is the DXBC parser in dxbc.c walking the whole shader, and "spirv"
+ * is the same parse followed by emission in spirv.c.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "windef.h"
+#include "winbase.h"
+#include "winnls.h"
+#include "psapi.h"
+#include <vkd3d_shader.h>
+
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(vkd3dbench);
+
+static unsigned int iterations = 10;
+static const char *default_profile;
+static const char *entry_point = "main";
+static LARGE_INTEGER frequency;
+
+struct stage_result
+{
+    unsigned int iterations;
+    double min_us, median_us;
+    size_t output_size;
+};
+
+static int __cdecl compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void init_compile_info(struct vkd3d_shader_compile_info *info, enum vkd3d_shader_source_type source_type,
+        const void *code, size_t size, enum vkd3d_shader_target_type target_type, const void *next)
+{
+    info->type = VKD3D_SHADER_STRUCTURE_TYPE_COMPILE_INFO;
+    info->next = next;
+    info->source.code = code;
+    info->source.size = size;
+    info->source_type = source_type;
+    info->target_type = target_type;
+    info->options = NULL;
+    info->option_count = 0;
+    info->log_level = VKD3D_SHADER_LOG_NONE;
+    info->source_name = NULL;
+}
+
+enum stage_op
+{
+    STAGE_COMPILE,
+    STAGE_PREPROCESS,
+    STAGE_SCAN,
+};
+
+/* Runs one stage "iterations" times. If "out" is not NULL, the output of the
+ * last iteration is returned in it, and must be freed by the caller. */
+static BOOL run_stage(enum stage_op op, const struct vkd3d_shader_compile_info *info,
+        struct stage_result *result, struct vkd3d_shader_code *out)
+{
+    struct vkd3d_shader_scan_descriptor_info descriptor_info;
+    struct vkd3d_shader_compile_info scan_info;
+    struct vkd3d_shader_code code;
+    LARGE_INTEGER start, end;
+    double *times;
+    unsigned int i;
+    int ret = 0;
+
+    if (!(times = malloc(iterations * sizeof(*times))))
+        return FALSE;
+
+    memset(result, 0, sizeof(*result));
+    for (i = 0; i < iterations; ++i)
+    {
+        memset(&code, 0, sizeof(code));
+
+        QueryPerformanceCounter(&start);
+        switch (op)
+        {
+            case STAGE_COMPILE:
+                ret = vkd3d_shader_compile(info, &code, NULL);
+                break;
+
+            case STAGE_PREPROCESS:
+                ret = vkd3d_shader_preprocess(info, &code, NULL);
+                break;
+
+            case STAGE_SCAN:
+                memset(&descriptor_info, 0, sizeof(descriptor_info));
+                descriptor_info.type = VKD3D_SHADER_STRUCTURE_TYPE_SCAN_DESCRIPTOR_INFO;
+                scan_info = *info;
+                scan_info.next = &descriptor_info;
+                if ((ret = vkd3d_shader_scan(&scan_info, NULL)) >= 0)
+                    vkd3d_shader_free_scan_descriptor_info(&descriptor_info);
+                break;
+        }
+        QueryPerformanceCounter(&end);
+
+        if (ret < 0)
+        {
+            WARN("Stage failed, ret %d.\n", ret);
+            free(times);
+            return FALSE;
+        }
+
+        times[i] = (end.QuadPart - start.QuadPart) * 1000000.0 / frequency.QuadPart;
+        result->output_size = code.size;
+        if (out && i == iterations - 1)
+            *out = code;
+        else
+            vkd3d_shader_free_shader_code(&code);
+    }
+
+    qsort(times, iterations, sizeof(*times), compare_double);
+    result->iterations = iterations;
+    result->min_us = times[0];
+    result->median_us = times[iterations / 2];
+    free(times);
+
+    return TRUE;
+}
+
+static void print_stage(const WCHAR *file, const char *source, const char *stage,
+        const struct stage_result *result)
+{
+    printf("compile\t%ls\t%s\t%s\t%u\t%.3f\t%.3f\t%Iu\n", file, source, stage,
+            result->iterations, result->min_us, result->median_us, result->output_size);
+}
+
+static void bench_dxbc(const WCHAR *file, const char *source, const void *code, size_t size)
+{
+    struct vkd3d_shader_spirv_target_info spirv_target;
+    struct vkd3d_shader_compile_info info;
+    struct stage_result result;
+
+    memset(&spirv_target, 0, sizeof(spirv_target));
+    spirv_target.type = VKD3D_SHADER_STRUCTURE_TYPE_SPIRV_TARGET_INFO;
+    spirv_target.environment = VKD3D_SHADER_SPIRV_ENVIRONMENT_VULKAN_1_0;
+
+    init_compile_info(&info, VKD3D_SHADER_SOURCE_DXBC_TPF, code, size, VKD3D_SHADER_TARGET_SPIRV_BINARY, NULL);
+    if (run_stage(STAGE_SCAN, &info, &result, NULL))
+        print_stage(file, source, "scan", &result);
+
+    info.next = &spirv_target;
+    if (run_stage(STAGE_COMPILE, &info, &result, NULL))
+        print_stage(file, source, "spirv", &result);
+
+    init_compile_info(&info, VKD3D_SHADER_SOURCE_DXBC_TPF, code, size, VKD3D_SHADER_TARGET_D3D_ASM, NULL);
+    if (run_stage(STAGE_COMPILE, &info, &result, NULL))
+        print_stage(file, source, "d3d-asm", &result);
+}
+
+static void bench_d3dbc(const WCHAR *file, const void *code, size_t size)
+{
+    struct vkd3d_shader_compile_info info;
+    struct stage_result result;
+
+    init_compile_info(&info, VKD3D_SHADER_SOURCE_D3D_BYTECODE, code, size, VKD3D_SHADER_TARGET_D3D_ASM, NULL);
+    if (run_stage(STAGE_COMPILE, &info, &result, NULL))
+        print_stage(file, "d3dbc", "d3d-asm", &result);
+}
+
+static BOOL get_profile_from_name(const WCHAR *file, char *profile, size_t size)
+{
+    const WCHAR *name, *ext, *p;
+    size_t i;
+
+    if ((name = wcsrchr(file, '\\')))
+        ++name;
+    else
+        name = file;
+
+    /* "name.<profile>.hlsl" */
+    if (!(ext = wcsrchr(name, '.')))
+        return FALSE;
+    for (p = ext; p > name && p[-1] != '.'; --p)
+        ;
+    if (p == name || ext - p >= size)
+        return FALSE;
+    for (i = 0; p + i < ext; ++i)
+        profile[i] = p[i];
+    profile[i] = 0;
+
+    return strchr(profile, '_') != NULL;
+}
+
+static void bench_hlsl(const WCHAR *file, const void *code, size_t size)
+{
+    struct vkd3d_shader_hlsl_source_info hlsl_info;
+    struct vkd3d_shader_compile_info info;
+    struct vkd3d_shader_code output;
+    struct stage_result result;
+    enum vkd3d_shader_target_type target_type;
+    char profile[32];
+
+    if (!get_profile_from_name(file, profile, ARRAY_SIZE(profile)))
+    {
+        if (!default_profile)
+        {
+            fprintf(stderr, "%ls: no profile given, skipping.\n", file);
+            return;
+        }
+        strcpy(profile, default_profile);
+    }
+
+    memset(&hlsl_info, 0, sizeof(hlsl_info));
+    hlsl_info.type = VKD3D_SHADER_STRUCTURE_TYPE_HLSL_SOURCE_INFO;
+    hlsl_info.entry_point = entry_point;
+    hlsl_info.profile = profile;
+
+    target_type = profile[3] >= '4' ? VKD3D_SHADER_TARGET_DXBC_TPF : VKD3D_SHADER_TARGET_D3D_BYTECODE;
+    init_compile_info(&info, VKD3D_SHADER_SOURCE_HLSL, code, size, target_type, &hlsl_info);
+
+    if (run_stage(STAGE_PREPROCESS, &info, &result, NULL))
+        print_stage(file, "hlsl", "preprocess", &result);
+
+    if (!run_stage(STAGE_COMPILE, &info, &result, &output))
+    {
+        fprintf(stderr, "%ls: failed to compile.\n", file);
+        return;
+    }
+    print_stage(file, "hlsl", target_type == VKD3D_SHADER_TARGET_DXBC_TPF ? "hlsl-sm4" : "hlsl-sm1", &result);
+
+    if (target_type == VKD3D_SHADER_TARGET_DXBC_TPF)
+        bench_dxbc(file, "hlsl", output.code, output.size);
+    else
+        bench_d3dbc(file, output.code, output.size);
+    vkd3d_shader_free_shader_code(&output);
+}
+
+static BOOL is_hlsl_name(const WCHAR *file)
+{
+    const WCHAR *ext;
+
+    if (!(ext = wcsrchr(file, '.')) || wcschr(ext, '\\'))
+        return FALSE;
+    return !wcsicmp(ext, L".hlsl") || !wcsicmp(ext, L".fx");
+}
+
+static void bench_file(const WCHAR *file)
+{
+    LARGE_INTEGER size;
+    const DWORD *token;
+    DWORD read;
+    HANDLE h;
+    void *code;
+
+    if ((h = CreateFileW(file, GENERIC_READ, FILE_SHARE_READ, NULL,
+            OPEN_EXISTING, 0, NULL)) == INVALID_HANDLE_VALUE)
+    {
+        fprintf(stderr, "%ls: failed to open, error %u.\n", file, GetLastError());
+        return;
+    }
+
+    if (!GetFileSizeEx(h, &size) || size.QuadPart > 64 * 1024 * 1024
+            || !(code = malloc(size.QuadPart + 1)))
+    {
+        CloseHandle(h);
+        return;
+    }
+
+    if (!ReadFile(h, code, size.QuadPart, &read, NULL) || read != size.QuadPart)
+    {
+        fprintf(stderr, "%ls: failed to read, error %u.\n", file, GetLastError());
+        free(code);
+        CloseHandle(h);
+        return;
+    }
+    CloseHandle(h);
+
+    token = code;
+    if (read >= 32 && !memcmp(code, "DXBC", 4))
+        bench_dxbc(file, "dxbc", code, read);
+    else if (read >= 4 && ((*token >> 16) == 0xfffe || (*token >> 16) == 0xffff))
+        bench_d3dbc(file, code, read);
+    else if (is_hlsl_name(file))
+        bench_hlsl(file, code, read);
+    else
+        TRACE("Ignoring %s.\n", debugstr_w(file));
+
+    free(code);
+}
+
+static void bench_path(const WCHAR *path)
+{
+    WIN32_FIND_DATAW data;
+    WCHAR *pattern, *file;
+    size_t len;
+    DWORD attr;
+    HANDLE h;
+
+    if ((attr = GetFileAttributesW(path)) == INVALID_FILE_ATTRIBUTES)
+    {
+        fprintf(stderr, "%ls: not found.\n", path);
+        return;
+    }
+
+    if (!(attr & FILE_ATTRIBUTE_DIRECTORY))
+    {
+        bench_file(path);
+        return;
+    }
+
+    len = wcslen(path);
+    if (!(pattern = malloc((len + 3) * sizeof(WCHAR))))
+        return;
+    swprintf(pattern, len + 3, L"%s\\*", path);
+
+    if ((h = FindFirstFileW(pattern, &data)) != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if (!wcscmp(data.cFileName, L".") || !wcscmp(data.cFileName, L".."))
+                continue;
+            if (!(file = malloc((len + wcslen(data.cFileName) + 2) * sizeof(WCHAR))))
+                break;
+            swprintf(file, len + wcslen(data.cFileName) + 2, L"%s\\%s", path, data.cFileName);
+            bench_path(file);
+            free(file);
+        } while (FindNextFileW(h, &data));
+        FindClose(h);
+    }
+
+    free(pattern);
+}
+
+static char *strdup_wtoa(const WCHAR *str)
+{
+    char *ret;
+    int len;
+
+    len = WideCharToMultiByte(CP_ACP, 0, str, -1, NULL, 0, NULL, NULL);
+    if ((ret = malloc(len)))
+        WideCharToMultiByte(CP_ACP, 0, str, -1, ret, len, NULL, NULL);
+    return ret;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: vkd3dbench [-n iterations] [-p profile] [-e entry_point] path...\n");
+}
+
+int __cdecl wmain(int argc, WCHAR *argv[])
+{
+    PROCESS_MEMORY_COUNTERS counters;
+    unsigned int paths = 0;
+    int i;
+
+    QueryPerformanceFrequency(&frequency);
+
+    for (i = 1; i < argc; ++i)
+    {
+        if (!wcscmp(argv[i], L"-n") && i + 1 < argc)
+        {
+            if (!(iterations = wcstoul(argv[++i], NULL, 10)))
+                iterations = 1;
+        }
+        else if (!wcscmp(argv[i], L"-p") && i + 1 < argc)
+        {
+            default_profile = strdup_wtoa(argv[++i]);
+        }
+        else if (!wcscmp(argv[i], L"-e") && i + 1 < argc)
+        {
+            entry_point = strdup_wtoa(argv[++i]);
+        }
+        else if (argv[i][0] == '-')
+        {
+            usage();
+            return 1;
+        }
+        else
+        {
+            ++paths;
+        }
+    }
+
+    if (!paths)
+    {
+        usage();
+        return 1;
+    }
+
+    for (i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] == '-')
+            ++i;
+        else
+            bench_path(argv[i]);
+    }
+
+    /* vkd3d-shader allocates through the C runtime, so individual
+     * allocations can't be counted from here; report the peaks instead. */
+    counters.cb = sizeof(counters);
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        printf("memory\t%Iu\t%Iu\n", counters.PeakWorkingSetSize, counters.PeakPagefileUsage);
+
+    return 0;
+}
@@ -763,18 +763,15 @@ DECL_HANDLER(get_async_result)
 }
 
 /* notify direct completion of async and close the wait handle if not blocking */
-DECL_HANDLER(set_async_direct_result)
+/* store the result of an I/O that the client performed on an alerted async */
+/* return the wait handle, or 0 if it has been closed */
+obj_handle_t async_set_direct_result( struct async *async, unsigned int status,
+                                      apc_param_t information, int mark_pending )
 {
-    struct async *async = (struct async *)get_handle_obj( current->process, req->handle, 0, &async_ops );
-    unsigned int status = req->status;
-
-    if (!async) return;
-
     if (!async->unknown_status || !async->terminated || !async->alerted)
     {
         set_error( STATUS_INVALID_PARAMETER );
-        release_object( &async->obj );
-        return;
+        return async->wait_handle;
     }
 
     if (status == STATUS_PENDING)
@@ -782,7 +779,7 @@ DECL_HANDLER(set_async_direct_result)
         async->direct_result = 0;
         async->pending = 1;
     }
-    else if (req->mark_pending)
+    else if (mark_pending)
     {
         async->pending = 1;
     }
@@ -792,7 +789,7 @@ DECL_HANDLER(set_async_direct_result)
      * therefore, we can do async_set_result() directly and let the client skip
      * waiting on wait_handle.
      */
-    async_set_result( &async->obj, status, req->information );
+    async_set_result( &async->obj, status, information );
 
     /* close wait handle here to avoid extra server round trip, if the I/O
      * either has completed, or is pending and not blocking.
@@ -802,12 +799,20 @@ DECL_HANDLER(set_async_direct_result)
         close_handle( async->thread->process, async->wait_handle );
         async->wait_handle = 0;
     }
+    return async->wait_handle;
+}
+
+DECL_HANDLER(set_async_direct_result)
+{
+    struct async *async = (struct async *)get_handle_obj( current->process, req->handle, 0, &async_ops );
+
+    if (!async) return;
 
     /* report back to the client whether the wait handle has been closed.
      * handle will be 0 if closed by us; otherwise the original value is
      * retained
      */
-    reply->handle = async->wait_handle;
+    reply->handle = async_set_direct_result( async, req->status, req->information, req->mark_pending );
 
     release_object( &async->obj );
 }
@@ -426,6 +426,7 @@ struct inode {
     dev_t dev;               /* device number */
     ino_t ino;               /* device's inode number */
     int wd;                  /* inotify's watch descriptor */
+    unsigned int mask;       /* inotify event mask of the watch */
     char *name;              /* basename name of the inode */
 };
 
@@ -475,6 +476,7 @@ static struct inode *create_inode( dev_t dev, ino_t ino )
         inode->ino = ino;
         inode->dev = dev;
         inode->wd = -1;
+        inode->mask = 0;
         inode->parent = NULL;
         inode->name = NULL;
         list_add_tail( get_hash_list( dev, ino ), &inode->ino_entry );
@@ -492,11 +494,14 @@ static struct inode *get_inode( dev_t dev, ino_t ino )
     return create_inode( dev, ino );
 }
 
-static void inode_set_wd( struct inode *inode, int wd )
+static int map_flags( unsigned int filter );
+
+static void inode_set_wd( struct inode *inode, int wd, unsigned int filter )
 {
     if (inode->wd != -1)
         list_remove( &inode->wd_entry );
     inode->wd = wd;
+    inode->mask = map_flags( filter );
     list_add_tail( &wd_hash[ wd % HASH_SIZE ], &inode->wd_entry );
 }
 
@@ -606,12 +611,23 @@ static void inotify_do_change_notify( struct dir *dir, unsigned int action,
                                       unsigned int cookie, const char *relpath )
 {
     struct change_record *record;
+    struct list *tail;
 
     assert( dir->obj.ops == &dir_ops );
 
     if (dir->want_data)
     {
         size_t len = strlen(relpath);
+
+        /* coalesce repeated modifications of the same file that haven't been read yet */
+        if (action == FILE_ACTION_MODIFIED && (tail = list_tail( &dir->change_records )))
+        {
+            record = LIST_ENTRY( tail, struct change_record, entry );
+            if (record->event.action == action && record->event.len == len &&
+                !memcmp( record->event.name, relpath, len ))
+                return;
+        }
+
         record = malloc( offsetof(struct change_record, event.name[len]) );
         if (!record)
             return;
@@ -727,7 +743,7 @@ static void inode_check_dir( struct inode *parent, const char *name )
 
     wd = inotify_add_dir( path, filter );
     if (wd != -1)
-        inode_set_wd( inode, wd );
+        inode_set_wd( inode, wd, filter );
     else
         free_inode( inode );
 
@@ -824,8 +840,8 @@ static void inotify_notify_all( struct inotify_event *ie )
 
 static void inotify_poll_event( struct fd *fd, int event )
 {
+    static char buffer[0x10000];  /* large enough to read a burst of events at once */
     int r, ofs, unix_fd;
-    char buffer[0x1000];
     struct inotify_event *ie;
 
     unix_fd = get_unix_fd( fd );
@@ -936,11 +952,15 @@ static int inotify_adjust_changes( struct dir *dir )
 
     filter = filter_from_inode( inode, 0 );
 
+    /* nothing to do if the watch is already set up with the same events */
+    if (inode->wd != -1 && inode->mask == map_flags( filter ))
+        return 1;
+
     sprintf( path, "/proc/self/fd/%u", unix_fd );
     wd = inotify_add_dir( path, filter );
     if (wd == -1) return 0;
 
-    inode_set_wd( inode, wd );
+    inode_set_wd( inode, wd, filter );
 
     return 1;
 }
@@ -1039,7 +1059,7 @@ static int dir_add_to_existing_notify( struct dir *dir )
 
     wd = inotify_add_dir( link, filter );
     if (wd != -1)
-        inode_set_wd( inode, wd );
+        inode_set_wd( inode, wd, filter );
 
     return 1;
 }
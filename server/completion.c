@@ -210,23 +210,29 @@ DECL_HANDLER(add_completion)
     release_object( completion );
 }
 
+/* remove the first message from the queue, the caller must free it */
+static struct comp_msg *remove_completion_msg( struct completion *completion )
+{
+    struct list *entry = list_head( &completion->queue );
+
+    if (!entry) return NULL;
+    list_remove( entry );
+    completion->depth--;
+    return LIST_ENTRY( entry, struct comp_msg, queue_entry );
+}
+
 /* get completion from completion port */
 DECL_HANDLER(remove_completion)
 {
     struct completion* completion = get_completion_obj( current->process, req->handle, IO_COMPLETION_MODIFY_STATE );
-    struct list *entry;
     struct comp_msg *msg;
 
     if (!completion) return;
 
-    entry = list_head( &completion->queue );
-    if (!entry)
+    if (!(msg = remove_completion_msg( completion )))
         set_error( STATUS_PENDING );
     else
     {
-        list_remove( entry );
-        completion->depth--;
-        msg = LIST_ENTRY( entry, struct comp_msg, queue_entry );
         reply->ckey = msg->ckey;
         reply->cvalue = msg->cvalue;
         reply->status = msg->status;
@@ -237,6 +243,35 @@ DECL_HANDLER(remove_completion)
     release_object( completion );
 }
 
+DECL_HANDLER(remove_completions)
+{
+    struct completion* completion = get_completion_obj( current->process, req->handle, IO_COMPLETION_MODIFY_STATE );
+    struct completion_info *info;
+    struct comp_msg *msg;
+    unsigned int i, count;
+
+    if (!completion) return;
+
+    count = min( completion->depth, get_reply_max_size() / sizeof(*info) );
+    if (!count)
+        set_error( STATUS_PENDING );
+    else if ((info = set_reply_data_size( count * sizeof(*info) )))
+    {
+        for (i = 0; i < count; i++)
+        {
+            msg = remove_completion_msg( completion );
+            info[i].ckey        = msg->ckey;
+            info[i].cvalue      = msg->cvalue;
+            info[i].information = msg->information;
+            info[i].status      = msg->status;
+            info[i].__pad       = 0;
+            free( msg );
+        }
+    }
+
+    release_object( completion );
+}
+
 /* get queue depth for completion port */
 DECL_HANDLER(query_completion)
 {
@@ -3020,6 +3020,30 @@ DECL_HANDLER(get_handle_fd)
     }
 }
 
+/* send the unix fd of a newly allocated handle to the client if it can be cached, */
+/* so that the client doesn't need a get_handle_fd request on first use */
+/* returns the fd type, or FD_TYPE_INVALID if no fd was sent */
+int send_cacheable_fd( struct process *process, obj_handle_t handle, struct object *obj,
+                       unsigned int *options )
+{
+    unsigned int error = get_error();
+    int type = FD_TYPE_INVALID;
+    struct fd *fd;
+
+    if ((fd = get_obj_fd( obj )))
+    {
+        if (fd->cacheable && fd->unix_fd != -1 &&
+            !send_client_fd( process, fd->unix_fd, handle | SERVER_PUSHED_FD_FLAG ))
+        {
+            type = fd->fd_ops->get_fd_type( fd );
+            *options = fd->options;
+        }
+        release_object( fd );
+    }
+    set_error( error );  /* preserve the status of the caller */
+    return type;
+}
+
 /* perform a read on a file object */
 DECL_HANDLER(read)
 {
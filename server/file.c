@@ -867,6 +867,11 @@ DECL_HANDLER(create_file)
             reply->handle = alloc_handle( current->process, file, req->access, objattr->attributes );
         else
             reply->handle = alloc_handle_no_access_check( current->process, file, req->access, objattr->attributes );
+        if (reply->handle)
+        {
+            reply->type = send_cacheable_fd( current->process, reply->handle, file, &reply->options );
+            reply->access = get_handle_access( current->process, reply->handle );
+        }
         release_object( file );
     }
     if (root_fd) release_object( root_fd );
@@ -101,6 +101,8 @@ extern void set_fd_events( struct fd *fd, int events );
 extern obj_handle_t lock_fd( struct fd *fd, file_pos_t offset, file_pos_t count, int shared, int wait );
 extern void unlock_fd( struct fd *fd, file_pos_t offset, file_pos_t count );
 extern void allow_fd_caching( struct fd *fd );
+extern int send_cacheable_fd( struct process *process, obj_handle_t handle, struct object *obj,
+                              unsigned int *options );
 extern void set_fd_signaled( struct fd *fd, int signaled );
 extern char *dup_fd_name( struct fd *root, const char *name );
 extern void get_nt_name( struct fd *fd, struct unicode_str *name );
@@ -136,6 +138,7 @@ struct timeout_user;
 extern timeout_t current_time;
 extern timeout_t monotonic_time;
 extern struct _KUSER_SHARED_DATA *user_shared_data;
+extern volatile unsigned int *sock_state;
 
 #define TICKS_PER_SEC 10000000
 
@@ -189,6 +192,8 @@ extern struct mapping *create_fd_mapping( struct object *root, const struct unic
                                           unsigned int attr, const struct security_descriptor *sd );
 extern struct object *create_user_data_mapping( struct object *root, const struct unicode_str *name,
                                                 unsigned int attr, const struct security_descriptor *sd );
+extern struct object *create_sock_state_mapping( struct object *root, const struct unicode_str *name,
+                                                 unsigned int attr, const struct security_descriptor *sd );
 
 /* device functions */
 
@@ -230,6 +235,8 @@ extern void free_async_queue( struct async_queue *queue );
 extern struct async *create_async( struct fd *fd, struct thread *thread, const async_data_t *data, struct iosb *iosb );
 extern struct async *create_request_async( struct fd *fd, unsigned int comp_flags, const async_data_t *data );
 extern obj_handle_t async_handoff( struct async *async, data_size_t *result, int force_blocking );
+extern obj_handle_t async_set_direct_result( struct async *async, unsigned int status,
+                                             apc_param_t information, int mark_pending );
 extern void queue_async( struct async_queue *queue, struct async *async );
 extern void async_set_timeout( struct async *async, timeout_t timeout, unsigned int status );
 extern void async_set_result( struct object *obj, unsigned int status, apc_param_t total );
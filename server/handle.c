@@ -45,14 +45,23 @@ struct handle_entry
     unsigned int   access;    /* access rights */
 };
 
+/* free entries are linked through their access field */
+#define NO_FREE_ENTRY (~0u)
+
 struct handle_table
 {
-    struct object        obj;         /* object header */
-    struct process      *process;     /* process owning this table */
-    int                  count;       /* number of allocated entries */
-    int                  last;        /* last used entry */
-    int                  free;        /* first entry that may be free */
-    struct handle_entry *entries;     /* handle entries */
+    struct object         obj;         /* object header */
+    struct process       *process;     /* process owning this table */
+    int                   count;       /* number of allocated entries */
+    int                   last;        /* last used entry */
+    unsigned int          free;        /* head of the free entries list */
+    unsigned int          free_count;  /* number of entries in the free list */
+    unsigned int          used;        /* number of entries in use */
+    unsigned int          peak;        /* peak number of entries in use */
+    unsigned int          allocs;      /* total number of allocated handles */
+    unsigned int          frees;       /* total number of closed handles */
+    unsigned int          compactions; /* number of times the table was shrunk */
+    struct handle_entry **pages;       /* pages of handle entries */
 };
 
 static struct handle_table *global_table;
@@ -63,7 +72,10 @@ static struct handle_table *global_table;
 #define RESERVED_CLOSE_PROTECT (HANDLE_FLAG_PROTECT_FROM_CLOSE << RESERVED_SHIFT)
 #define RESERVED_ALL           (RESERVED_INHERIT | RESERVED_CLOSE_PROTECT)
 
-#define MIN_HANDLE_ENTRIES  32
+/* entries are allocated in fixed size pages, so that growing the table never moves them */
+#define HANDLE_PAGE_SHIFT   8
+#define HANDLE_PAGE_ENTRIES (1 << HANDLE_PAGE_SHIFT)
+#define HANDLE_PAGE_MASK    (HANDLE_PAGE_ENTRIES - 1)
 #define MAX_HANDLE_ENTRIES  0x00ffffff
 
 
@@ -79,6 +91,12 @@ static inline int handle_to_index( obj_handle_t handle )
     return (handle >> 2) - 1;
 }
 
+/* return the entry for a given index, which must be below the table count */
+static inline struct handle_entry *get_entry( struct handle_table *table, int index )
+{
+    return table->pages[index >> HANDLE_PAGE_SHIFT] + (index & HANDLE_PAGE_MASK);
+}
+
 /* global handle conversion */
 
 #define HANDLE_OBFUSCATOR 0x544a4def
@@ -152,12 +170,12 @@ static void handle_table_dump( struct object *obj, int verbose )
 
     assert( obj->ops == &handle_table_ops );
 
-    fprintf( stderr, "Handle table last=%d count=%d process=%p\n",
-             table->last, table->count, table->process );
+    fprintf( stderr, "Handle table last=%d count=%d used=%u process=%p\n",
+             table->last, table->count, table->used, table->process );
     if (!verbose) return;
-    entry = table->entries;
-    for (i = 0; i <= table->last; i++, entry++)
+    for (i = 0; i <= table->last; i++)
     {
+        entry = get_entry( table, i );
         if (!entry->ptr) continue;
         fprintf( stderr, "    %04x: %p %08x ",
                  index_to_handle(i), entry->ptr, entry->access );
@@ -175,9 +193,12 @@ static void handle_table_destroy( struct object *obj )
 
     assert( obj->ops == &handle_table_ops );
 
-    for (i = 0, entry = table->entries; i <= table->last; i++, entry++)
+    for (i = 0; i <= table->last; i++)
     {
-        struct object *obj = entry->ptr;
+        struct object *obj;
+
+        entry = get_entry( table, i );
+        obj = entry->ptr;
         entry->ptr = NULL;
         if (obj)
         {
@@ -186,7 +207,8 @@ static void handle_table_destroy( struct object *obj )
             release_object_from_handle( obj );
         }
     }
-    free( table->entries );
+    for (i = 0; i < table->count >> HANDLE_PAGE_SHIFT; i++) free( table->pages[i] );
+    free( table->pages );
 }
 
 /* close all the process handles and free the handle table */
@@ -198,57 +220,100 @@ void close_process_handles( struct process *process )
     if (table) release_object( table );
 }
 
-/* allocate a new handle table */
-struct handle_table *alloc_handle_table( struct process *process, int count )
+/* rebuild the list of free entries, lowest index first */
+static void rebuild_free_list( struct handle_table *table )
 {
-    struct handle_table *table;
+    struct handle_entry *entry;
+    int i;
 
-    if (count < MIN_HANDLE_ENTRIES) count = MIN_HANDLE_ENTRIES;
-    if (!(table = alloc_object( &handle_table_ops )))
-        return NULL;
-    table->process = process;
-    table->count   = count;
-    table->last    = -1;
-    table->free    = 0;
-    if ((table->entries = mem_alloc( count * sizeof(*table->entries) ))) return table;
-    release_object( table );
-    return NULL;
+    table->free = NO_FREE_ENTRY;
+    table->free_count = 0;
+    for (i = table->count - 1; i >= 0; i--)
+    {
+        entry = get_entry( table, i );
+        if (entry->ptr) continue;
+        entry->access = table->free;
+        table->free = i;
+        table->free_count++;
+    }
 }
 
-/* grow a handle table */
+/* grow a handle table by one page, and add the new entries to the free list */
 static int grow_handle_table( struct handle_table *table )
 {
-    struct handle_entry *new_entries;
-    int count = min( table->count * 2, MAX_HANDLE_ENTRIES );
+    struct handle_entry **new_pages, *page;
+    int i, nb_pages = table->count >> HANDLE_PAGE_SHIFT;
 
-    if (count == table->count ||
-        !(new_entries = realloc( table->entries, count * sizeof(struct handle_entry) )))
+    if (table->count + HANDLE_PAGE_ENTRIES > MAX_HANDLE_ENTRIES ||
+        !(new_pages = realloc( table->pages, (nb_pages + 1) * sizeof(*new_pages) )))
     {
         set_error( STATUS_INSUFFICIENT_RESOURCES );
         return 0;
     }
-    table->entries = new_entries;
-    table->count   = count;
+    table->pages = new_pages;
+    if (!(page = malloc( HANDLE_PAGE_ENTRIES * sizeof(*page) )))
+    {
+        set_error( STATUS_INSUFFICIENT_RESOURCES );
+        return 0;
+    }
+    table->pages[nb_pages] = page;
+    for (i = HANDLE_PAGE_ENTRIES - 1; i >= 0; i--)
+    {
+        page[i].ptr    = NULL;
+        page[i].access = table->free;
+        table->free = table->count + i;
+    }
+    table->count += HANDLE_PAGE_ENTRIES;
+    table->free_count += HANDLE_PAGE_ENTRIES;
     return 1;
 }
 
-/* allocate the first free entry in the handle table */
+/* allocate a new handle table */
+struct handle_table *alloc_handle_table( struct process *process, int count )
+{
+    struct handle_table *table;
+
+    if (!(table = alloc_object( &handle_table_ops )))
+        return NULL;
+    table->process     = process;
+    table->count       = 0;
+    table->last        = -1;
+    table->free        = NO_FREE_ENTRY;
+    table->free_count  = 0;
+    table->used        = 0;
+    table->peak        = 0;
+    table->allocs      = 0;
+    table->frees       = 0;
+    table->compactions = 0;
+    table->pages       = NULL;
+    do
+    {
+        if (!grow_handle_table( table ))
+        {
+            release_object( table );
+            return NULL;
+        }
+    } while (table->count < count);
+    if (table->count > HANDLE_PAGE_ENTRIES) rebuild_free_list( table );
+    return table;
+}
+
+/* allocate the first entry of the free list */
 static obj_handle_t alloc_entry( struct handle_table *table, void *obj, unsigned int access )
 {
-    struct handle_entry *entry = table->entries + table->free;
+    struct handle_entry *entry;
     int i;
 
-    for (i = table->free; i <= table->last; i++, entry++) if (!entry->ptr) goto found;
-    if (i >= table->count)
-    {
-        if (!grow_handle_table( table )) return 0;
-        entry = table->entries + i;  /* the entries may have moved */
-    }
-    table->last = i;
- found:
-    table->free = i + 1;
+    if (table->free == NO_FREE_ENTRY && !grow_handle_table( table )) return 0;
+    i = table->free;
+    entry = get_entry( table, i );
+    table->free = entry->access;
+    table->free_count--;
+    if (i > table->last) table->last = i;
     entry->ptr    = grab_object_for_handle( obj );
     entry->access = access;
+    table->allocs++;
+    if (++table->used > table->peak) table->peak = table->used;
     return index_to_handle(i);
 }
 
@@ -327,7 +392,7 @@ static struct handle_entry *get_handle( struct process *process, obj_handle_t ha
     index = handle_to_index( handle );
     if (index < 0) return NULL;
     if (index > table->last) return NULL;
-    entry = table->entries + index;
+    entry = get_entry( table, index );
     if (!entry->ptr) return NULL;
     return entry;
 }
@@ -335,22 +400,34 @@ static struct handle_entry *get_handle( struct process *process, obj_handle_t ha
 /* attempt to shrink a table */
 static void shrink_handle_table( struct handle_table *table )
 {
-    struct handle_entry *entry = table->entries + table->last;
-    struct handle_entry *new_entries;
-    int count = table->count;
+    struct handle_entry **new_pages;
+    int i, nb_pages = table->count >> HANDLE_PAGE_SHIFT;
 
     while (table->last >= 0)
     {
-        if (entry->ptr) break;
+        if (get_entry( table, table->last )->ptr) break;
         table->last--;
-        entry--;
     }
-    if (table->last >= count / 4) return;  /* no need to shrink */
-    if (count < MIN_HANDLE_ENTRIES * 2) return;  /* too small to shrink */
-    count /= 2;
-    if (!(new_entries = realloc( table->entries, count * sizeof(*new_entries) ))) return;
-    table->count   = count;
-    table->entries = new_entries;
+    if (table->last >= table->count / 4) return;  /* no need to shrink */
+    if (nb_pages < 2) return;  /* too small to shrink */
+    for (i = nb_pages / 2; i < nb_pages; i++) free( table->pages[i] );
+    nb_pages /= 2;
+    table->count = nb_pages << HANDLE_PAGE_SHIFT;
+    if ((new_pages = realloc( table->pages, nb_pages * sizeof(*new_pages) ))) table->pages = new_pages;
+    table->compactions++;
+    /* the free list may point into the released pages */
+    rebuild_free_list( table );
+}
+
+/* put an entry back on the free list once its object has been removed */
+static void free_entry( struct handle_table *table, struct handle_entry *entry, int index )
+{
+    entry->access = table->free;
+    table->free = index;
+    table->free_count++;
+    table->used--;
+    table->frees++;
+    if (index == table->last) shrink_handle_table( table );
 }
 
 static void inherit_handle( struct process *parent, const obj_handle_t handle, struct handle_table *table )
@@ -358,14 +435,13 @@ static void inherit_handle( struct process *parent, const obj_handle_t handle, s
     struct handle_entry *dst, *src;
     int index;
 
-    dst = table->entries;
-
     src = get_handle( parent, handle );
     if (!src || !(src->access & RESERVED_INHERIT)) return;
     index = handle_to_index( handle );
-    if (dst[index].ptr) return;
+    dst = get_entry( table, index );
+    if (dst->ptr) return;
     grab_object_for_handle( src->ptr );
-    dst[index] = *src;
+    *dst = *src;
     table->last = max( table->last, index );
 }
 
@@ -387,8 +463,6 @@ struct handle_table *copy_handle_table( struct process *process, struct process
 
     if (handles)
     {
-        memset( table->entries, 0, parent_table->count * sizeof(*table->entries) );
-
         for (i = 0; i < handle_count; i++)
         {
             inherit_handle( parent, handles[i], table );
@@ -401,18 +475,20 @@ struct handle_table *copy_handle_table( struct process *process, struct process
     }
     else
     {
-        if ((table->last = parent_table->last) >= 0)
+        table->last = parent_table->last;
+        for (i = 0; i <= table->last; i++)
         {
-            struct handle_entry *ptr = table->entries;
-            memcpy( ptr, parent_table->entries, (table->last + 1) * sizeof(struct handle_entry) );
-            for (i = 0; i <= table->last; i++, ptr++)
-            {
-                if (!ptr->ptr) continue;
-                if (ptr->access & RESERVED_INHERIT) grab_object_for_handle( ptr->ptr );
-                else ptr->ptr = NULL; /* don't inherit this entry */
-            }
+            struct handle_entry *ptr = get_entry( table, i );
+
+            *ptr = *get_entry( parent_table, i );
+            if (!ptr->ptr) continue;
+            if (ptr->access & RESERVED_INHERIT) grab_object_for_handle( ptr->ptr );
+            else ptr->ptr = NULL; /* don't inherit this entry */
         }
     }
+    for (i = 0; i <= table->last; i++) if (get_entry( table, i )->ptr) table->used++;
+    table->peak = table->used;
+    rebuild_free_list( table );
     /* attempt to shrink the table */
     shrink_handle_table( table );
     return table;
@@ -424,15 +500,24 @@ unsigned int close_handle( struct process *process, obj_handle_t handle )
     struct handle_table *table;
     struct handle_entry *entry;
     struct object *obj;
+    int index;
 
     if (!(entry = get_handle( process, handle ))) return STATUS_INVALID_HANDLE;
     if (entry->access & RESERVED_CLOSE_PROTECT) return STATUS_HANDLE_NOT_CLOSABLE;
     obj = entry->ptr;
     if (!obj->ops->close_handle( obj, process, handle )) return STATUS_HANDLE_NOT_CLOSABLE;
     entry->ptr = NULL;
-    table = handle_is_global(handle) ? global_table : process->handles;
-    if (entry < table->entries + table->free) table->free = entry - table->entries;
-    if (entry == table->entries + table->last) shrink_handle_table( table );
+    if (handle_is_global(handle))
+    {
+        table = global_table;
+        index = handle_to_index( handle_global_to_local( handle ));
+    }
+    else
+    {
+        table = process->handles;
+        index = handle_to_index( handle );
+    }
+    free_entry( table, entry, index );
     release_object_from_handle( obj );
     return STATUS_SUCCESS;
 }
@@ -512,8 +597,9 @@ obj_handle_t find_inherited_handle( struct process *process, const struct object
 
     if (!table) return 0;
 
-    for (i = 0, ptr = table->entries; i <= table->last; i++, ptr++)
+    for (i = 0; i <= table->last; i++)
     {
+        ptr = get_entry( table, i );
         if (!ptr->ptr) continue;
         if (ptr->ptr->ops != ops) continue;
         if (ptr->access & RESERVED_INHERIT) return index_to_handle(i);
@@ -633,11 +719,11 @@ obj_handle_t open_object( struct process *process, obj_handle_t parent, unsigned
     return handle;
 }
 
-/* return the size of the handle table of a given process */
+/* return the number of open handles of a given process */
 unsigned int get_handle_table_count( struct process *process )
 {
     if (!process->handles) return 0;
-    return process->handles->count;
+    return process->handles->used;
 }
 
 /* close a handle */
@@ -679,6 +765,27 @@ DECL_HANDLER(dup_handle)
     }
 }
 
+/* retrieve the handle table statistics of a process */
+DECL_HANDLER(get_handle_table_stats)
+{
+    struct process *process;
+    struct handle_table *table;
+
+    if (!(process = get_process_from_handle( req->handle, PROCESS_QUERY_LIMITED_INFORMATION ))) return;
+
+    if ((table = process->handles))
+    {
+        reply->count       = table->count;
+        reply->used        = table->used;
+        reply->peak        = table->peak;
+        reply->free_count  = table->free_count;
+        reply->allocs      = table->allocs;
+        reply->frees       = table->frees;
+        reply->compactions = table->compactions;
+    }
+    release_object( process );
+}
+
 DECL_HANDLER(get_object_info)
 {
     struct object *obj;
@@ -824,8 +931,9 @@ static int enum_handles( struct process *process, void *user )
     if (!table)
         return 0;
 
-    for (i = 0, entry = table->entries; i <= table->last; i++, entry++)
+    for (i = 0; i <= table->last; i++)
     {
+        entry = get_entry( table, i );
         if (!entry->ptr) continue;
         if (!info->handle)
         {
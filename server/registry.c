@@ -29,6 +29,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
@@ -92,6 +93,12 @@ struct key
     unsigned int      flags;       /* flags */
     timeout_t         modif;       /* last modification time */
     struct list       notify_list; /* list of notifications */
+    struct name_index *subkey_index; /* hashed index of subkeys, for large keys */
+    struct name_index *value_index;  /* hashed index of values, for large keys */
+    data_size_t       max_subkey;  /* cached longest subkey name, valid if KEY_INFO_VALID */
+    data_size_t       max_class;   /* cached longest subkey class */
+    data_size_t       max_value;   /* cached longest value name */
+    data_size_t       max_data;    /* cached longest value data */
 };
 
 /* key flags */
@@ -102,6 +109,7 @@ struct key
 #define KEY_WOW64    0x0010  /* key contains a Wow6432Node subkey */
 #define KEY_WOWSHARE 0x0020  /* key is a Wow64 shared key (used for Software\Classes) */
 #define KEY_PREDEF   0x0040  /* key is marked as predefined */
+#define KEY_INFO_VALID 0x0080  /* cached maximum lengths are up to date */
 
 /* a key value */
 struct key_value
@@ -113,8 +121,24 @@ struct key_value
     void             *data;    /* pointer to value data */
 };
 
+/* hashed index of the subkey or value names of a key; it maps the case-insensitive
+ * hash of a name to its position in the sorted array, using linear probing */
+struct name_index
+{
+    unsigned int      size;    /* number of slots, a power of two */
+    unsigned int      count;   /* number of used slots */
+    struct
+    {
+        unsigned int  hash;    /* hash of the name */
+        int           pos;     /* position in the array, -1 if the slot is unused */
+    } slots[1];
+};
+
 #define MIN_SUBKEYS  8   /* min. number of allocated subkeys per key */
 #define MIN_VALUES   8   /* min. number of allocated values per key */
+#define MIN_INDEXED  64  /* min. number of subkeys or values for building an index */
+
+#define FILE_BUFFER_SIZE 0x10000  /* stdio buffer size for loading and saving registry files */
 
 #define MAX_NAME_LEN  256    /* max. length of a key name */
 #define MAX_VALUE_LEN 16383  /* max. length of a value name */
@@ -125,6 +149,7 @@ static struct key *root_key;
 static const timeout_t ticks_1601_to_1970 = (timeout_t)86400 * (369 * 365 + 89) * TICKS_PER_SEC;
 static const timeout_t save_period = 30 * -TICKS_PER_SEC;  /* delay between periodic saves */
 static struct timeout_user *save_timeout_user;  /* saving timer */
+static struct save_process *save_process;  /* background save process, if one is running */
 static enum prefix_type { PREFIX_UNKNOWN, PREFIX_32BIT, PREFIX_64BIT } prefix_type;
 
 static const WCHAR root_name[] = { '\\','R','e','g','i','s','t','r','y','\\' };
@@ -196,6 +221,56 @@ static const struct object_ops key_ops =
 };
 
 
+/* process saving the registry in the background */
+struct save_process
+{
+    struct object  obj;      /* object header */
+    struct fd     *fd;       /* pipe to the save process */
+    unsigned int   pending;  /* mask of the branches being saved */
+};
+
+static void save_process_dump( struct object *obj, int verbose );
+static void save_process_destroy( struct object *obj );
+
+static const struct object_ops save_process_ops =
+{
+    sizeof(struct save_process), /* size */
+    &no_type,                /* type */
+    save_process_dump,       /* dump */
+    no_add_queue,            /* add_queue */
+    NULL,                    /* remove_queue */
+    NULL,                    /* signaled */
+    NULL,                    /* get_esync_fd */
+    NULL,                    /* satisfied */
+    no_signal,               /* signal */
+    no_get_fd,               /* get_fd */
+    default_map_access,      /* map_access */
+    default_get_sd,          /* get_sd */
+    default_set_sd,          /* set_sd */
+    no_get_full_name,        /* get_full_name */
+    no_lookup_name,          /* lookup_name */
+    no_link_name,            /* link_name */
+    NULL,                    /* unlink_name */
+    no_open_file,            /* open_file */
+    no_kernel_obj_list,      /* get_kernel_obj_list */
+    no_close_handle,         /* close_handle */
+    save_process_destroy     /* destroy */
+};
+
+static void save_process_poll_event( struct fd *fd, int event );
+
+static const struct fd_ops save_process_fd_ops =
+{
+    NULL,                    /* get_poll_events */
+    save_process_poll_event, /* poll_event */
+    NULL,                    /* flush */
+    NULL,                    /* get_fd_type */
+    NULL,                    /* ioctl */
+    NULL,                    /* queue_async */
+    NULL                     /* reselect_async */
+};
+
+
 static inline int is_wow6432node( const WCHAR *name, unsigned int len )
 {
     return (len == sizeof(wow6432node) && !memicmp_strW( name, wow6432node, sizeof( wow6432node )));
@@ -224,7 +299,10 @@ static void dump_path( const struct key *key, const struct key *base, FILE *f )
 /* dump a value to a text file */
 static void dump_value( const struct key_value *value, FILE *f )
 {
-    unsigned int i, dw;
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char *data = value->data;
+    char buffer[128];  /* large enough for a full line of hex data */
+    unsigned int i, dw, pos;
     int count;
 
     if (value->namelen)
@@ -259,20 +337,26 @@ static void dump_value( const struct key_value *value, FILE *f )
 
     if (value->type == REG_BINARY) count += fprintf( f, "hex:" );
     else count += fprintf( f, "hex(%x):", value->type );
-    for (i = 0; i < value->len; i++)
+    /* format the hex data ourselves a line at a time, fprintf is too slow for large values */
+    for (i = pos = 0; i < value->len; i++)
     {
-        count += fprintf( f, "%02x", *((unsigned char *)value->data + i) );
+        buffer[pos++] = hex[data[i] >> 4];
+        buffer[pos++] = hex[data[i] & 0x0f];
+        count += 2;
         if (i < value->len-1)
         {
-            fputc( ',', f );
+            buffer[pos++] = ',';
             if (++count > 76)
             {
-                fprintf( f, "\\\n  " );
+                memcpy( buffer + pos, "\\\n  ", 4 );
+                fwrite( buffer, 1, pos + 4, f );
+                pos = 0;
                 count = 2;
             }
         }
     }
-    fputc( '\n', f );
+    buffer[pos++] = '\n';
+    fwrite( buffer, 1, pos, f );
 }
 
 /* save a registry and all its subkeys to a text file */
@@ -452,6 +536,8 @@ static void key_destroy( struct object *obj )
         free( key->values[i].data );
     }
     free( key->values );
+    free( key->value_index );
+    free( key->subkey_index );
     for (i = 0; i <= key->last_subkey; i++)
     {
         key->subkeys[i]->parent = NULL;
@@ -523,6 +609,8 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
         key->nb_values   = 0;
         key->last_value  = -1;
         key->values      = NULL;
+        key->subkey_index = NULL;
+        key->value_index = NULL;
         key->modif       = modif;
         key->parent      = NULL;
         list_init( &key->notify_list );
@@ -535,6 +623,147 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
     return key;
 }
 
+static inline unsigned int hash_name( const WCHAR *name, data_size_t len )
+{
+    return hash_strW( name, len, ~0u );
+}
+
+/* allocate an empty name index large enough for count entries */
+static struct name_index *alloc_name_index( unsigned int count )
+{
+    struct name_index *index;
+    unsigned int i, size = 2 * MIN_INDEXED;
+
+    while (size < 2 * count) size *= 2;
+    if (!(index = malloc( offsetof( struct name_index, slots[size] ) ))) return NULL;
+    index->size  = size;
+    index->count = 0;
+    for (i = 0; i < size; i++) index->slots[i].pos = -1;
+    return index;
+}
+
+/* add an entry to a name index, without updating the other positions */
+static void add_index_entry( struct name_index *index, unsigned int hash, int pos )
+{
+    unsigned int i = hash & (index->size - 1);
+
+    while (index->slots[i].pos != -1) i = (i + 1) & (index->size - 1);
+    index->slots[i].hash = hash;
+    index->slots[i].pos  = pos;
+    index->count++;
+}
+
+/* return the next position in the index whose name has the given hash, or -1 at the end */
+/* the slot must be initialized to the hash before the first call */
+static int find_index_entry( const struct name_index *index, unsigned int hash, unsigned int *slot )
+{
+    unsigned int i;
+
+    for (i = *slot & (index->size - 1); index->slots[i].pos != -1; i = (i + 1) & (index->size - 1))
+    {
+        if (index->slots[i].hash != hash) continue;
+        *slot = i + 1;
+        return index->slots[i].pos;
+    }
+    return -1;
+}
+
+/* insert a new entry at a given position of the indexed array */
+/* on failure the index is freed, and lookups fall back to a binary search */
+static void insert_index_entry( struct name_index **index_ptr, unsigned int hash, int pos )
+{
+    struct name_index *index = *index_ptr, *new_index;
+    unsigned int i;
+
+    /* nothing to renumber when appending, as when loading a sorted key */
+    if ((unsigned int)pos < index->count)
+        for (i = 0; i < index->size; i++) if (index->slots[i].pos >= pos) index->slots[i].pos++;
+
+    if (2 * (index->count + 1) > index->size)
+    {
+        if (!(new_index = alloc_name_index( index->count + 1 )))
+        {
+            free( index );
+            *index_ptr = NULL;
+            return;
+        }
+        for (i = 0; i < index->size; i++)
+            if (index->slots[i].pos != -1)
+                add_index_entry( new_index, index->slots[i].hash, index->slots[i].pos );
+        free( index );
+        *index_ptr = index = new_index;
+    }
+    add_index_entry( index, hash, pos );
+}
+
+/* remove the entry at a given position of the indexed array */
+static void remove_index_entry( struct name_index *index, unsigned int hash, int pos )
+{
+    unsigned int i, j, k, mask = index->size - 1;
+
+    for (i = hash & mask; index->slots[i].pos != pos; i = (i + 1) & mask)
+        assert( index->slots[i].pos != -1 );
+
+    /* move back the following entries of the cluster that hash before the freed slot */
+    for (j = (i + 1) & mask; index->slots[j].pos != -1; j = (j + 1) & mask)
+    {
+        k = index->slots[j].hash & mask;
+        if (i <= j ? (i < k && k <= j) : (i < k || k <= j)) continue;
+        index->slots[i] = index->slots[j];
+        i = j;
+    }
+    index->slots[i].pos = -1;
+    index->count--;
+
+    if ((unsigned int)pos < index->count)
+        for (i = 0; i < index->size; i++) if (index->slots[i].pos > pos) index->slots[i].pos--;
+}
+
+/* build the index of the subkeys of a key */
+static void build_subkey_index( struct key *key )
+{
+    int i;
+
+    if (!(key->subkey_index = alloc_name_index( key->last_subkey + 1 ))) return;
+    for (i = 0; i <= key->last_subkey; i++)
+        add_index_entry( key->subkey_index, hash_name( key->subkeys[i]->name, key->subkeys[i]->namelen ), i );
+}
+
+/* build the index of the values of a key */
+static void build_value_index( struct key *key )
+{
+    int i;
+
+    if (!(key->value_index = alloc_name_index( key->last_value + 1 ))) return;
+    for (i = 0; i <= key->last_value; i++)
+        add_index_entry( key->value_index, hash_name( key->values[i].name, key->values[i].namelen ), i );
+}
+
+/* invalidate the cached maximum lengths of a key, after a subkey or value change */
+static inline void invalidate_key_info( struct key *key )
+{
+    if (key) key->flags &= ~KEY_INFO_VALID;
+}
+
+/* recompute the cached maximum lengths of a key */
+static void update_key_info( struct key *key )
+{
+    int i;
+
+    key->max_subkey = key->max_class = key->max_value = key->max_data = 0;
+    for (i = 0; i <= key->last_subkey; i++)
+    {
+        if (key->subkeys[i]->namelen > key->max_subkey) key->max_subkey = key->subkeys[i]->namelen;
+        if (key->subkeys[i]->classlen > key->max_class) key->max_class = key->subkeys[i]->classlen;
+    }
+    for (i = 0; i <= key->last_value; i++)
+    {
+        if (key->values[i].namelen > key->max_value) key->max_value = key->values[i].namelen;
+        if (key->values[i].len > key->max_data) key->max_data = key->values[i].len;
+    }
+    key->flags |= KEY_INFO_VALID;
+}
+
 /* mark a key and all its parents as dirty (modified) */
 static void make_dirty( struct key *key )
 {
@@ -614,7 +843,6 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
                                  int index, timeout_t modif )
 {
     struct key *key;
-    int i;
 
     if (name->len > MAX_NAME_LEN * sizeof(WCHAR))
     {
@@ -629,9 +857,14 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
     if ((key = alloc_key( name, modif )) != NULL)
     {
         key->parent = parent;
-        for (i = ++parent->last_subkey; i > index; i--)
-            parent->subkeys[i] = parent->subkeys[i-1];
+        memmove( parent->subkeys + index + 1, parent->subkeys + index,
+                 (++parent->last_subkey - index) * sizeof(*parent->subkeys) );
         parent->subkeys[index] = key;
+        if (parent->subkey_index)
+            insert_index_entry( &parent->subkey_index, hash_name( key->name, key->namelen ), index );
+        else if (parent->last_subkey + 1 >= MIN_INDEXED)
+            build_subkey_index( parent );
+        invalidate_key_info( parent );
         if (is_wow6432node( key->name, key->namelen ) && !is_wow6432node( parent->name, parent->namelen ))
             parent->flags |= KEY_WOW64;
     }
@@ -642,14 +875,18 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
 static void free_subkey( struct key *parent, int index )
 {
     struct key *key;
-    int i, nb_subkeys;
+    int nb_subkeys;
 
     assert( index >= 0 );
     assert( index <= parent->last_subkey );
 
     key = parent->subkeys[index];
-    for (i = index; i < parent->last_subkey; i++) parent->subkeys[i] = parent->subkeys[i + 1];
+    if (parent->subkey_index)
+        remove_index_entry( parent->subkey_index, hash_name( key->name, key->namelen ), index );
+    memmove( parent->subkeys + index, parent->subkeys + index + 1,
+             (parent->last_subkey - index) * sizeof(*parent->subkeys) );
     parent->last_subkey--;
+    invalidate_key_info( parent );
     key->flags |= KEY_DELETED;
     key->parent = NULL;
     if (is_wow6432node( key->name, key->namelen )) parent->flags &= ~KEY_WOW64;
@@ -674,6 +911,20 @@ static struct key *find_subkey( const struct key *key, const struct unicode_str
     int i, min, max, res;
     data_size_t len;
 
+    if (key->subkey_index)
+    {
+        unsigned int hash = hash_name( name->str, name->len ), slot = hash;
+
+        while ((i = find_index_entry( key->subkey_index, hash, &slot )) != -1)
+        {
+            if (key->subkeys[i]->namelen != name->len) continue;
+            if (memicmp_strW( key->subkeys[i]->name, name->str, name->len )) continue;
+            *index = i;
+            return key->subkeys[i];
+        }
+        /* not found, the binary search is only needed for the insertion point */
+    }
+
     min = 0;
     max = key->last_subkey;
     while (min <= max)
@@ -862,6 +1113,7 @@ static struct key *create_key( struct key *key, const struct unicode_str *name,
         key->classlen = class->len;
         free(key->class);
         if (!(key->class = memdup( class->str, key->classlen ))) key->classlen = 0;
+        invalidate_key_info( key->parent );
     }
     touch_key( key->parent, REG_NOTIFY_CHANGE_NAME );
     grab_object( key );
@@ -914,10 +1166,7 @@ static struct key *create_key_recursive( struct key *key, const struct unicode_s
 /* query information about a key or a subkey */
 static void enum_key( struct key *key, int index, int info_class, struct enum_key_reply *reply )
 {
-    int i;
     data_size_t len, namelen, classlen;
-    data_size_t max_subkey = 0, max_class = 0;
-    data_size_t max_value = 0, max_data = 0;
     WCHAR *fullname = NULL;
     char *data;
 
@@ -956,20 +1205,11 @@ static void enum_key( struct key *key, int index, int info_class, struct enum_ke
         break;
     case KeyFullInformation:
     case KeyCachedInformation:
-        for (i = 0; i <= key->last_subkey; i++)
-        {
-            if (key->subkeys[i]->namelen > max_subkey) max_subkey = key->subkeys[i]->namelen;
-            if (key->subkeys[i]->classlen > max_class) max_class = key->subkeys[i]->classlen;
-        }
-        for (i = 0; i <= key->last_value; i++)
-        {
-            if (key->values[i].namelen > max_value) max_value = key->values[i].namelen;
-            if (key->values[i].len > max_data) max_data = key->values[i].len;
-        }
-        reply->max_subkey = max_subkey;
-        reply->max_class  = max_class;
-        reply->max_value  = max_value;
-        reply->max_data   = max_data;
+        if (!(key->flags & KEY_INFO_VALID)) update_key_info( key );
+        reply->max_subkey = key->max_subkey;
+        reply->max_class  = key->max_class;
+        reply->max_value  = key->max_value;
+        reply->max_data   = key->max_data;
         reply->namelen    = namelen;
         if (info_class == KeyCachedInformation)
             classlen = 0; /* don't return any data, only its size */
@@ -1013,6 +1253,7 @@ static int delete_key( struct key *key, int recurse )
 {
     int index;
     struct key *parent = key->parent;
+    struct unicode_str name;
 
     /* must find parent and index */
     if (key == root_key)
@@ -1032,9 +1273,9 @@ static int delete_key( struct key *key, int recurse )
         if (0 > delete_key(key->subkeys[key->last_subkey], 1))
             return -1;
 
-    for (index = 0; index <= parent->last_subkey; index++)
-        if (parent->subkeys[index] == key) break;
-    assert( index <= parent->last_subkey );
+    name.str = key->name;
+    name.len = key->namelen;
+    if (find_subkey( parent, &name, &index ) != key) assert( 0 );
 
     /* we can only delete a key that has no subkeys */
     if (key->last_subkey >= 0)
@@ -1080,6 +1321,19 @@ static struct key_value *find_value( const struct key *key, const struct unicode
     int i, min, max, res;
     data_size_t len;
 
+    if (key->value_index)
+    {
+        unsigned int hash = hash_name( name->str, name->len ), slot = hash;
+
+        while ((i = find_index_entry( key->value_index, hash, &slot )) != -1)
+        {
+            if (key->values[i].namelen != name->len) continue;
+            if (memicmp_strW( key->values[i].name, name->str, name->len )) continue;
+            *index = i;
+            return &key->values[i];
+        }
+    }
+
     min = 0;
     max = key->last_value;
     while (min <= max)
@@ -1105,7 +1359,6 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
 {
     struct key_value *value;
     WCHAR *new_name = NULL;
-    int i;
 
     if (name->len > MAX_VALUE_LEN * sizeof(WCHAR))
     {
@@ -1117,12 +1370,18 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
         if (!grow_values( key )) return NULL;
     }
     if (name->len && !(new_name = memdup( name->str, name->len ))) return NULL;
-    for (i = ++key->last_value; i > index; i--) key->values[i] = key->values[i - 1];
+    memmove( key->values + index + 1, key->values + index,
+             (++key->last_value - index) * sizeof(*key->values) );
     value = &key->values[index];
     value->name    = new_name;
     value->namelen = name->len;
     value->len     = 0;
     value->data    = NULL;
+    if (key->value_index)
+        insert_index_entry( &key->value_index, hash_name( name->str, name->len ), index );
+    else if (key->last_value + 1 >= MIN_INDEXED)
+        build_value_index( key );
+    invalidate_key_info( key );
     return value;
 }
 
@@ -1176,6 +1435,7 @@ static void set_value( struct key *key, const struct unicode_str *name,
     value->type  = type;
     value->len   = len;
     value->data  = ptr;
+    invalidate_key_info( key );
     touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
     if (debug_level > 1) dump_operation( key, value, "Set" );
 }
@@ -1267,7 +1527,7 @@ static void enum_value( struct key *key, int i, int info_class, struct enum_key_
 static void delete_value( struct key *key, const struct unicode_str *name )
 {
     struct key_value *value;
-    int i, index, nb_values;
+    int index, nb_values;
 
     if (key->flags & KEY_PREDEF)
     {
@@ -1281,10 +1541,13 @@ static void delete_value( struct key *key, const struct unicode_str *name )
         return;
     }
     if (debug_level > 1) dump_operation( key, value, "Delete" );
+    if (key->value_index) remove_index_entry( key->value_index, hash_name( value->name, value->namelen ), index );
     free( value->name );
     free( value->data );
-    for (i = index; i < key->last_value; i++) key->values[i] = key->values[i + 1];
+    memmove( key->values + index, key->values + index + 1,
+             (key->last_value - index) * sizeof(*key->values) );
     key->last_value--;
+    invalidate_key_info( key );
     touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
 
     /* try to shrink the array */
@@ -1519,26 +1782,37 @@ static int load_key_option( struct key *key, const char *buffer, struct file_loa
         free( key->class );
         if (!(key->class = memdup( info->tmp, len ))) len = 0;
         key->classlen = len;
+        invalidate_key_info( key->parent );
     }
     if (!strncmp( buffer, "#link", 5 )) key->flags |= KEY_SYMLINK;
     /* ignore unknown options */
     return 1;
 }
 
+static inline unsigned int hex_value( char ch )
+{
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    return (ch | 0x20) - 'a' + 10;
+}
+
 /* parse a comma-separated list of hex digits */
 static int parse_hex( unsigned char *dest, data_size_t *len, const char *buffer )
 {
     const char *p = buffer;
     data_size_t count = 0;
-    char *end;
 
     while (isxdigit(*p))
     {
-        unsigned int val = strtoul( p, &end, 16 );
-        if (end == p || val > 0xff) return -1;
+        unsigned int val = 0;
+
+        /* this is called for every byte of binary values, so avoid strtoul */
+        while (isxdigit(*p))
+        {
+            val = (val << 4) | hex_value( *p++ );
+            if (val > 0xff) return -1;
+        }
         if (count++ >= *len) return -1;  /* dest buffer overflow */
         *dest++ = val;
-        p = end;
         while (isspace(*p)) p++;
         if (*p == ',') p++;
         while (isspace(*p)) p++;
@@ -1638,6 +1912,7 @@ static int load_value( struct key *key, const char *buffer, struct file_load_inf
     free( value->data );
     value->data = newptr;
     value->len  = len;
+    invalidate_key_info( key );
     value->type = type;
     return 1;
 
@@ -1688,7 +1963,7 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
 
     info.filename = filename;
     info.file   = f;
-    info.len    = 4;
+    info.len    = 256;
     info.tmplen = 4;
     info.line   = 0;
     if (!(info.buffer = mem_alloc( info.len ))) return;
@@ -1777,6 +2052,7 @@ static int load_init_registry_from_file( const char *filename, struct key *key )
 
     if ((f = fopen( filename, "r" )))
     {
+        setvbuf( f, NULL, _IOFBF, FILE_BUFFER_SIZE );
         load_keys( key, filename, f, 0 );
         fclose( f );
         if (get_error() == STATUS_NOT_REGISTRY_FILE)
@@ -2060,6 +2336,7 @@ static int save_branch( struct key *key, const char *path )
         close( fd );
         goto done;
     }
+    setvbuf( f, NULL, _IOFBF, FILE_BUFFER_SIZE );
 
     if (debug_level > 1)
     {
@@ -2083,16 +2360,115 @@ done:
     return ret;
 }
 
+static void save_process_dump( struct object *obj, int verbose )
+{
+    struct save_process *process = (struct save_process *)obj;
+    fprintf( stderr, "Registry save process fd=%p pending=%x\n", process->fd, process->pending );
+}
+
+static void save_process_destroy( struct object *obj )
+{
+    struct save_process *process = (struct save_process *)obj;
+    if (process->fd) release_object( process->fd );
+}
+
+/* process the result of the background save; wait for it if requested */
+static void finish_background_save( int wait )
+{
+    unsigned char failed;
+    int i, ret, unix_fd;
+
+    if (!save_process) return;
+    unix_fd = get_unix_fd( save_process->fd );
+    if (wait) fcntl( unix_fd, F_SETFL, 0 );
+    while ((ret = read( unix_fd, &failed, 1 )) == -1 && errno == EINTR);
+    if (ret == -1 && errno == EAGAIN) return;
+    if (ret != 1) failed = save_process->pending;  /* the save process died */
+
+    /* mark the branches that couldn't be saved as dirty again */
+    for (i = 0; i < save_branch_count; i++)
+        if (failed & (1 << i)) make_dirty( save_branch_info[i].key );
+
+    release_object( save_process );
+    save_process = NULL;
+}
+
+static void save_process_poll_event( struct fd *fd, int event )
+{
+    finish_background_save( 0 );
+}
+
+/* save the dirty registry branches from a forked process, so that the server isn't blocked */
+/* the child gets a snapshot of the registry, and reports the failed branches through a pipe */
+static int save_in_background(void)
+{
+#ifdef USE_PTRACE  /* child processes are only reaped when using ptrace */
+    struct save_process *process;
+    unsigned char failed = 0;
+    unsigned int dirty = 0;
+    int i, fds[2];
+    pid_t pid;
+
+    for (i = 0; i < save_branch_count; i++)
+        if (save_branch_info[i].key->flags & KEY_DIRTY) dirty |= 1 << i;
+    if (!dirty) return 1;
+
+    if (pipe( fds ) == -1) return 0;
+    switch ((pid = fork()))
+    {
+    case -1:
+        close( fds[0] );
+        close( fds[1] );
+        return 0;
+    case 0:  /* child */
+        close( fds[0] );
+        for (i = 0; i < save_branch_count; i++)
+            if (!save_branch( save_branch_info[i].key, save_branch_info[i].path )) failed |= 1 << i;
+        /* if the result is lost, the parent considers that all the branches failed */
+        _exit( write( fds[1], &failed, 1 ) != 1 );
+    default:  /* parent */
+        close( fds[1] );
+        fcntl( fds[0], F_SETFL, O_NONBLOCK );
+        if (!(process = alloc_object( &save_process_ops )))
+        {
+            close( fds[0] );  /* the save still happens, but its result is ignored */
+            return 1;
+        }
+        process->pending = dirty;
+        if (!(process->fd = create_anonymous_fd( &save_process_fd_ops, fds[0], &process->obj, 0 )))
+        {
+            release_object( process );
+            return 1;
+        }
+        set_fd_events( process->fd, POLLIN );
+        save_process = process;
+        /* the snapshot is saved, later changes will make the keys dirty again */
+        for (i = 0; i < save_branch_count; i++)
+            if (dirty & (1 << i)) make_clean( save_branch_info[i].key );
+        return 1;
+    }
+#else
+    return 0;
+#endif
+}
+
 /* periodic saving of the registry */
 static void periodic_save( void *arg )
 {
     int i;
 
-    if (fchdir( config_dir_fd ) == -1) return;
     save_timeout_user = NULL;
-    for (i = 0; i < save_branch_count; i++)
-        save_branch( save_branch_info[i].key, save_branch_info[i].path );
-    if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
+    /* skip this round if the previous save is still running */
+    if (!save_process)
+    {
+        if (fchdir( config_dir_fd ) == -1) return;
+        if (!save_in_background())
+        {
+            for (i = 0; i < save_branch_count; i++)
+                save_branch( save_branch_info[i].key, save_branch_info[i].path );
+        }
+        if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
+    }
     set_periodic_save_timer();
 }
 
@@ -2108,6 +2484,7 @@ void flush_registry(void)
 {
     int i;
 
+    finish_background_save( 1 );
     if (fchdir( config_dir_fd ) == -1) return;
     for (i = 0; i < save_branch_count; i++)
     {
@@ -328,24 +328,49 @@ static void call_req_handler( struct thread *thread )
 /* read a request from a thread */
 void read_request( struct thread *thread )
 {
+    static char inline_data[4096];  /* buffer to read small request data along with the header */
+    struct iovec vec[2];
     int ret;
 
     if (!thread->req_toread)  /* no pending request */
     {
-        if ((ret = read( get_unix_fd( thread->request_fd ), &thread->req,
-                         sizeof(thread->req) )) != sizeof(thread->req)) goto error;
+        /* the client only has one request in flight, so it's safe to read ahead */
+        vec[0].iov_base = &thread->req;
+        vec[0].iov_len  = sizeof(thread->req);
+        vec[1].iov_base = inline_data;
+        vec[1].iov_len  = sizeof(inline_data);
+        if ((ret = readv( get_unix_fd( thread->request_fd ), vec, 2 )) < (int)sizeof(thread->req)) goto error;
+        ret -= sizeof(thread->req);
         if (!(thread->req_toread = thread->req.request_header.request_size))
         {
             /* no data, handle request at once */
+            if (ret)
+            {
+                fatal_protocol_error( thread, "unexpected request data %d\n", ret );
+                return;
+            }
             call_req_handler( thread );
             return;
         }
+        if (ret > thread->req_toread)
+        {
+            fatal_protocol_error( thread, "unexpected request data %d\n", ret );
+            return;
+        }
         if (!(thread->req_data = malloc( thread->req_toread )))
         {
             fatal_protocol_error( thread, "no memory for %u bytes request %d\n",
                                   thread->req_toread, thread->req.request_header.req );
             return;
         }
+        memcpy( thread->req_data, inline_data, ret );
+        if (!(thread->req_toread -= ret))
+        {
+            call_req_handler( thread );
+            free( thread->req_data );
+            thread->req_data = NULL;
+            return;
+        }
     }
 
     /* read the variable sized data */
@@ -223,6 +223,7 @@ struct sock
     unsigned int        aborted : 1; /* did we get a POLLERR or irregular POLLHUP? */
     unsigned int        nonblocking : 1; /* is the socket nonblocking? */
     unsigned int        bound : 1;   /* is the socket bound? */
+    unsigned int        state_serial; /* serial of the published state, 0 if none */
 };
 
 static void sock_dump( struct object *obj, int verbose );
@@ -568,6 +569,53 @@ void sock_init(void)
     }
 }
 
+volatile unsigned int *sock_state = NULL;  /* state of the sockets, shared with the clients */
+static unsigned int sock_state_used;  /* number of slots allocated at least once */
+static unsigned int sock_state_nb_free;  /* number of released slots */
+static unsigned int sock_state_free[SOCK_STATE_SLOTS];  /* released slots */
+static unsigned short sock_state_gen[SOCK_STATE_SLOTS];  /* generation of the slot serials */
+
+/* publish whether synchronous I/O may be done before calling the server, that is */
+/* when no asyncs are queued before it and the socket isn't shut down */
+static void sock_update_state( struct sock *sock )
+{
+    unsigned int state = sock->state_serial << SOCK_STATE_SERIAL_SHIFT;
+
+    if (!sock->state_serial) return;
+    if (!sock->rd_shutdown && !async_queued( &sock->read_q )) state |= SOCK_STATE_DIRECT_RECV;
+    if (!sock->wr_shutdown && !async_queued( &sock->write_q )) state |= SOCK_STATE_DIRECT_SEND;
+    sock_state[sock->state_serial % SOCK_STATE_SLOTS] = state;
+}
+
+/* allocate a slot for the published state of a socket */
+static void sock_alloc_state( struct sock *sock )
+{
+    unsigned int slot;
+
+    if (!sock_state || sock->state_serial) return;
+
+    if (sock_state_nb_free) slot = sock_state_free[--sock_state_nb_free];
+    else if (sock_state_used < SOCK_STATE_SLOTS) slot = sock_state_used++;
+    else return;  /* all the slots are in use, the socket always calls the server first */
+
+    /* a new serial for the slot, so that stale client references to it are ignored */
+    if (++sock_state_gen[slot] > (~0u >> SOCK_STATE_SERIAL_SHIFT) / SOCK_STATE_SLOTS)
+        sock_state_gen[slot] = 1;
+    sock->state_serial = sock_state_gen[slot] * SOCK_STATE_SLOTS + slot;
+    sock_update_state( sock );
+}
+
+/* release the slot of the published state of a socket */
+static void sock_free_state( struct sock *sock )
+{
+    unsigned int slot = sock->state_serial % SOCK_STATE_SLOTS;
+
+    if (!sock->state_serial) return;
+    sock_state[slot] = 0;
+    sock_state_free[sock_state_nb_free++] = slot;
+    sock->state_serial = 0;
+}
+
 static int sock_reselect( struct sock *sock )
 {
     int ev = sock_get_poll_events( sock->fd );
@@ -1396,12 +1444,24 @@ static void sock_reselect_async( struct fd *fd, struct async_queue *queue )
 {
     struct sock *sock = get_fd_user( fd );
 
+    sock_update_state( sock );
+
     if (sock->wr_shutdown_pending && list_empty( &sock->write_q.queue ))
     {
         shutdown( get_unix_fd( sock->fd ), SHUT_WR );
         sock->wr_shutdown_pending = 0;
     }
 
+    /* When a datagram read completes and more datagrams are already queued,
+     * alert the next read right away instead of going through the main loop
+     * again, so that a burst of packets completes the pending reads in one pass. */
+    if (queue == &sock->read_q && sock->type == WS_SOCK_DGRAM && !sock->rd_shutdown &&
+        async_waiting( &sock->read_q ) && (check_fd_events( sock->fd, POLLIN ) & POLLIN))
+    {
+        if (debug_level) fprintf( stderr, "activating read queue for socket %p\n", sock );
+        async_wake_up( &sock->read_q, STATUS_ALERTED );
+    }
+
     /* Don't reselect the ifchange queue; we always ask for POLLIN.
      * Don't reselect an uninitialized socket; we can't call set_fd_events() on
      * a pseudo-fd. */
@@ -1477,6 +1537,7 @@ static void sock_destroy( struct object *obj )
     free_async_queue( &sock->accept_q );
     free_async_queue( &sock->connect_q );
     free_async_queue( &sock->poll_q );
+    sock_free_state( sock );
     if (sock->event) release_object( sock->event );
     if (sock->fd)
     {
@@ -1519,6 +1580,7 @@ static struct sock *create_socket(void)
     sock->aborted = 0;
     sock->nonblocking = 0;
     sock->bound = 0;
+    sock->state_serial = 0;
     sock->rcvbuf = 0;
     sock->sndbuf = 0;
     sock->rcvtimeo = 0;
@@ -2446,6 +2508,7 @@ static void sock_ioctl( struct fd *fd, ioctl_code_t code, struct async *async )
             else
                 sock->wr_shutdown_pending = 1;
         }
+        sock_update_state( sock );
 
         if (how == SD_BOTH)
         {
@@ -3431,7 +3494,7 @@ struct object *create_socket_device( struct object *root, const struct unicode_s
 DECL_HANDLER(recv_socket)
 {
     struct sock *sock = (struct sock *)get_handle_obj( current->process, req->async.handle, 0, &sock_ops );
-    unsigned int status = STATUS_PENDING;
+    unsigned int status = STATUS_PENDING, direct_status = STATUS_PENDING;
     timeout_t timeout = 0;
     struct async *async;
     struct fd *fd;
@@ -3439,10 +3502,19 @@ DECL_HANDLER(recv_socket)
     if (!sock) return;
     fd = sock->fd;
 
+    sock_alloc_state( sock );
+
     if (!req->force_async && !sock->nonblocking && is_fd_overlapped( fd ))
         timeout = (timeout_t)sock->rcvtimeo * -10000;
 
-    if (sock->rd_shutdown) status = STATUS_PIPE_DISCONNECTED;
+    if (req->status != STATUS_PENDING)
+    {
+        /* The client already received the data, as published by
+         * sock_update_state(), only report the result. */
+        status = STATUS_ALERTED;
+        direct_status = req->status;
+    }
+    else if (sock->rd_shutdown) status = STATUS_PIPE_DISCONNECTED;
     else if (!async_queued( &sock->read_q ))
     {
         /* If read_q is not empty, we cannot really tell if the already queued
@@ -3482,8 +3554,15 @@ DECL_HANDLER(recv_socket)
         sock_reselect( sock );
 
         reply->wait = async_handoff( async, NULL, 0 );
+        if (direct_status != STATUS_PENDING)
+        {
+            reply->wait = async_set_direct_result( async, direct_status, req->total, FALSE );
+            set_error( direct_status );
+        }
+        sock_update_state( sock );
         reply->options = get_fd_options( fd );
         reply->nonblocking = sock->nonblocking;
+        reply->state_serial = sock->state_serial;
         release_object( async );
     }
     release_object( sock );
@@ -3511,7 +3590,7 @@ static void send_socket_completion_callback( void *private )
 DECL_HANDLER(send_socket)
 {
     struct sock *sock = (struct sock *)get_handle_obj( current->process, req->async.handle, 0, &sock_ops );
-    unsigned int status = STATUS_PENDING;
+    unsigned int status = STATUS_PENDING, direct_status = STATUS_PENDING;
     timeout_t timeout = 0;
     struct async *async;
     struct fd *fd;
@@ -3520,14 +3599,17 @@ DECL_HANDLER(send_socket)
     if (!sock) return;
     fd = sock->fd;
 
+    sock_alloc_state( sock );
+
     if (sock->type == WS_SOCK_DGRAM && !sock->bound)
     {
         union unix_sockaddr unix_addr;
         socklen_t unix_len;
         int unix_fd = get_unix_fd( fd );
 
+        /* the client's send may already have bound the socket */
         unix_len = get_unix_sockaddr_any( &unix_addr, sock->family );
-        if (bind( unix_fd, &unix_addr.addr, unix_len ) < 0)
+        if (bind( unix_fd, &unix_addr.addr, unix_len ) < 0 && errno != EINVAL)
             bind_errno = errno;
 
         if (getsockname( unix_fd, &unix_addr.addr, &unix_len ) >= 0)
@@ -3541,7 +3623,14 @@ DECL_HANDLER(send_socket)
     if (!req->force_async && !sock->nonblocking && is_fd_overlapped( fd ))
         timeout = (timeout_t)sock->sndtimeo * -10000;
 
-    if (bind_errno) status = sock_get_ntstatus( bind_errno );
+    if (req->status != STATUS_PENDING)
+    {
+        /* The client already sent the data, as published by
+         * sock_update_state(), only report the result. */
+        status = STATUS_ALERTED;
+        direct_status = req->status;
+    }
+    else if (bind_errno) status = sock_get_ntstatus( bind_errno );
     else if (sock->wr_shutdown) status = STATUS_PIPE_DISCONNECTED;
     else if (!async_queued( &sock->write_q ))
     {
@@ -3563,7 +3652,16 @@ DECL_HANDLER(send_socket)
     }
 
     if (status == STATUS_PENDING && !req->force_async && sock->nonblocking)
-        status = STATUS_DEVICE_NOT_READY;
+    {
+        /* If the client had a short write and the socket is nonblocking,
+         * report success, see the comment in sock_send(). */
+        if (req->total)
+        {
+            status = STATUS_ALERTED;
+            direct_status = STATUS_SUCCESS;
+        }
+        else status = STATUS_DEVICE_NOT_READY;
+    }
 
     if ((async = create_request_async( fd, get_fd_comp_flags( fd ), &req->async )))
     {
@@ -3593,8 +3691,15 @@ DECL_HANDLER(send_socket)
         }
 
         reply->wait = async_handoff( async, NULL, 0 );
+        if (direct_status != STATUS_PENDING)
+        {
+            reply->wait = async_set_direct_result( async, direct_status, req->total, FALSE );
+            set_error( direct_status );
+        }
+        sock_update_state( sock );
         reply->options = get_fd_options( fd );
         reply->nonblocking = sock->nonblocking;
+        reply->state_serial = sock->state_serial;
         release_object( async );
     }
     release_object( sock );
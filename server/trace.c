@@ -1349,6 +1349,25 @@ static void dump_varargs_handle_infos( const char *prefix, data_size_t size )
     fputc( '}', stderr );
 }
 
+static void dump_varargs_completion_infos( const char *prefix, data_size_t size )
+{
+    const struct completion_info *info;
+
+    fprintf( stderr, "%s{", prefix );
+    while (size >= sizeof(*info))
+    {
+        info = cur_data;
+        dump_uint64( "{ckey=", &info->ckey );
+        dump_uint64( ",cvalue=", &info->cvalue );
+        dump_uint64( ",information=", &info->information );
+        fprintf( stderr, ",status=%s}", get_status_name( info->status ) );
+        size -= sizeof(*info);
+        remove_data( sizeof(*info) );
+        if (size) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+}
+
 typedef void (*dump_func)( const void *req );
 
 /* Everything below this line is generated automatically by tools/make_requests */
@@ -1908,6 +1927,9 @@ static void dump_create_file_request( const struct create_file_request *req )
 static void dump_create_file_reply( const struct create_file_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", type=%d", req->type );
+    fprintf( stderr, ", access=%08x", req->access );
+    fprintf( stderr, ", options=%08x", req->options );
 }
 
 static void dump_open_file_object_request( const struct open_file_object_request *req )
@@ -2031,9 +2053,11 @@ static void dump_unlock_file_request( const struct unlock_file_request *req )
 
 static void dump_recv_socket_request( const struct recv_socket_request *req )
 {
-    fprintf( stderr, " oob=%d", req->oob );
+    fprintf( stderr, " oob=%04x", req->oob );
+    fprintf( stderr, ", force_async=%04x", req->force_async );
     dump_async_data( ", async=", &req->async );
-    fprintf( stderr, ", force_async=%d", req->force_async );
+    fprintf( stderr, ", status=%08x", req->status );
+    fprintf( stderr, ", total=%u", req->total );
 }
 
 static void dump_recv_socket_reply( const struct recv_socket_reply *req )
@@ -2041,12 +2065,15 @@ static void dump_recv_socket_reply( const struct recv_socket_reply *req )
     fprintf( stderr, " wait=%04x", req->wait );
     fprintf( stderr, ", options=%08x", req->options );
     fprintf( stderr, ", nonblocking=%d", req->nonblocking );
+    fprintf( stderr, ", state_serial=%08x", req->state_serial );
 }
 
 static void dump_send_socket_request( const struct send_socket_request *req )
 {
-    dump_async_data( " async=", &req->async );
+    fprintf( stderr, " status=%08x", req->status );
+    dump_async_data( ", async=", &req->async );
     fprintf( stderr, ", force_async=%d", req->force_async );
+    fprintf( stderr, ", total=%u", req->total );
 }
 
 static void dump_send_socket_reply( const struct send_socket_reply *req )
@@ -2054,6 +2081,7 @@ static void dump_send_socket_reply( const struct send_socket_reply *req )
     fprintf( stderr, " wait=%04x", req->wait );
     fprintf( stderr, ", options=%08x", req->options );
     fprintf( stderr, ", nonblocking=%d", req->nonblocking );
+    fprintf( stderr, ", state_serial=%08x", req->state_serial );
 }
 
 static void dump_get_next_console_request_request( const struct get_next_console_request_request *req )
@@ -3927,6 +3955,22 @@ static void dump_get_system_handles_reply( const struct get_system_handles_reply
     dump_varargs_handle_infos( ", data=", cur_size );
 }
 
+static void dump_get_handle_table_stats_request( const struct get_handle_table_stats_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_get_handle_table_stats_reply( const struct get_handle_table_stats_reply *req )
+{
+    fprintf( stderr, " count=%08x", req->count );
+    fprintf( stderr, ", used=%08x", req->used );
+    fprintf( stderr, ", peak=%08x", req->peak );
+    fprintf( stderr, ", free_count=%08x", req->free_count );
+    fprintf( stderr, ", allocs=%08x", req->allocs );
+    fprintf( stderr, ", frees=%08x", req->frees );
+    fprintf( stderr, ", compactions=%08x", req->compactions );
+}
+
 static void dump_create_mailslot_request( const struct create_mailslot_request *req )
 {
     fprintf( stderr, " access=%08x", req->access );
@@ -4251,6 +4295,16 @@ static void dump_remove_completion_reply( const struct remove_completion_reply *
     fprintf( stderr, ", status=%08x", req->status );
 }
 
+static void dump_remove_completions_request( const struct remove_completions_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_remove_completions_reply( const struct remove_completions_reply *req )
+{
+    dump_varargs_completion_infos( " infos=", cur_size );
+}
+
 static void dump_query_completion_request( const struct query_completion_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -4764,6 +4818,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_set_security_object_request,
     (dump_func)dump_get_security_object_request,
     (dump_func)dump_get_system_handles_request,
+    (dump_func)dump_get_handle_table_stats_request,
     (dump_func)dump_create_mailslot_request,
     (dump_func)dump_set_mailslot_info_request,
     (dump_func)dump_create_directory_request,
@@ -4793,6 +4848,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_completion_request,
     (dump_func)dump_add_completion_request,
     (dump_func)dump_remove_completion_request,
+    (dump_func)dump_remove_completions_request,
     (dump_func)dump_query_completion_request,
     (dump_func)dump_set_completion_info_request,
     (dump_func)dump_add_fd_completion_request,
@@ -5048,6 +5104,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     NULL,
     (dump_func)dump_get_security_object_reply,
     (dump_func)dump_get_system_handles_reply,
+    (dump_func)dump_get_handle_table_stats_reply,
     (dump_func)dump_create_mailslot_reply,
     (dump_func)dump_set_mailslot_info_reply,
     (dump_func)dump_create_directory_reply,
@@ -5077,6 +5134,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_completion_reply,
     NULL,
     (dump_func)dump_remove_completion_reply,
+    (dump_func)dump_remove_completions_reply,
     (dump_func)dump_query_completion_reply,
     NULL,
     NULL,
@@ -5332,6 +5390,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "set_security_object",
     "get_security_object",
     "get_system_handles",
+    "get_handle_table_stats",
     "create_mailslot",
     "set_mailslot_info",
     "create_directory",
@@ -5361,6 +5420,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "open_completion",
     "add_completion",
     "remove_completion",
+    "remove_completions",
     "query_completion",
     "set_completion_info",
     "add_fd_completion",